@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include "Benchmark.h"
+#include "Checks.h"
+#include "DocumentGenerator.h"
+#include "FXPlatform/NanoTrace.h"
+using namespace std;
+
+// Counts every allocation in the process so the benchmarks can report allocations per KB parsed
+namespace
+{
+    atomic<long long> allocationCount(0);
+}
+
+void *operator new(size_t size)
+{
+    ++allocationCount;
+    void *memory = malloc(size == 0 ? 1 : size);
+    if(memory == nullptr)
+    {
+        throw bad_alloc();
+    }
+
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+long long Benchmark::allocations()
+{
+    return allocationCount;
+}
+
+namespace
+{
+    // The checked in documents in Bench/Corpus
+    const char *corpusFiles[][2] =
+    {
+        { "catalog.xml", "xml" },
+        { "page.html", "html" },
+        { "site.css", "css" },
+    };
+
+    bool ReadFile(const string &fullPath, string &contents)
+    {
+        ifstream file(fullPath, ios::binary);
+        if(!file.good())
+        {
+            return false;
+        }
+
+        stringstream stream;
+        stream << file.rdbuf();
+        contents = stream.str();
+        return true;
+    }
+
+    int Usage()
+    {
+        fprintf(stdout,
+            "Measures how fast the parsers are.\r\n\r\n"
+            "Command line arguments: \r\n"
+            "	indparse_bench [--runs count] [--sizes 64K,256K] [--shapes typical,deep,...] [--seed number] [--depth levels] [--arena] [--flat] [--validate] [--events] [--timings] [--corpus directory] [--json file] \r\n"
+            "		Runs the benchmarks, printing the results and writing them as JSON to file if given \r\n"
+            "		Each shape (see indparse_gen) is generated at each size, deep documents nest depth levels (default 1000) \r\n"
+            "		--arena allocates the Symbols from a SymbolArena \r\n"
+            "		--flat has the compilers process a FlatAst instead of the Symbols \r\n"
+            "		--validate only checks that the documents parse, without building a tree \r\n"
+            "		--events has the compilers get the tree as events while it is parsed \r\n"
+            "		--timings afterwards prints the stats for everything the compilers timed (see NanoTrace::Timings()) \r\n"
+            "	indparse_bench --compare baseline.json current.json [--threshold percent] \r\n"
+            "		Compares two runs, fails if anything regressed by more than percent (default 5) \r\n"
+            "	indparse_bench --check [--sizes 64K,256K] [--shapes typical,deep,...] [--seed number] [--depth levels] [--corpus directory] \r\n"
+            "		Checks that flattening Symbols as they are added makes the same trees as flattening the whole tree afterwards \r\n"
+            "		and that the documents the benchmarks use parse the same way in every mode: validating fails the same way compiling does, \r\n"
+            "		events are the same as the finished tree's and the FlatAst, memoizing and streams \r\n"
+            "		(and memory mapped files for the corpus) get the same tree. Also checks that XmlEventCompiler doesn't keep \r\n"
+            "		more Symbols for a wide XML document when it gets bigger \r\n"
+            );
+        return 2;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 5;
+    string sizes = "64K,256K";
+    string shapes = "typical,deep,wide,attributes,text,nearmiss";
+    unsigned int seed = 1;
+    int depth = DocumentGenerator::DefaultMaxDepth;
+    bool useArena = false;
+    bool flatAst = false;
+    bool validate = false;
+    bool events = false;
+    bool timings = false;
+    string corpus = INDPARSE_BENCH_CORPUS;
+    string jsonPath;
+    double threshold = 5;
+    vector<string> compare;
+    bool check = false;
+    for(int index = 1; index < argc; ++index)
+    {
+        string argument = argv[index];
+        bool hasValue = index + 1 < argc;
+        if(argument == "--runs" && hasValue) { runs = max(1, atoi(argv[++index])); }
+        else if(argument == "--sizes" && hasValue) { sizes = argv[++index]; }
+        else if(argument == "--shapes" && hasValue) { shapes = argv[++index]; }
+        else if(argument == "--seed" && hasValue) { seed = (unsigned int) strtoul(argv[++index], nullptr, 10); }
+        else if(argument == "--depth" && hasValue) { depth = max(1, atoi(argv[++index])); }
+        else if(argument == "--arena") { useArena = true; }
+        else if(argument == "--flat") { flatAst = true; }
+        else if(argument == "--validate") { validate = true; }
+        else if(argument == "--events") { events = true; }
+        else if(argument == "--timings") { timings = true; }
+        else if(argument == "--corpus" && hasValue) { corpus = argv[++index]; }
+        else if(argument == "--json" && hasValue) { jsonPath = argv[++index]; }
+        else if(argument == "--threshold" && hasValue) { threshold = atof(argv[++index]); }
+        else if(argument == "--compare" && index + 2 < argc) { compare.push_back(argv[++index]); compare.push_back(argv[++index]); }
+        else if(argument == "--check") { check = true; }
+        else { return Usage(); }
+    }
+
+    if(compare.size() > 0)
+    {
+        vector<BenchmarkResult> baseline;
+        vector<BenchmarkResult> current;
+        string error;
+        if(!Benchmark::ReadJson(compare[0], baseline, error) || !Benchmark::ReadJson(compare[1], current, error))
+        {
+            fprintf(stdout, "%s\r\n", error.c_str());
+            return 2;
+        }
+
+        return Benchmark::Compare(baseline, current, threshold, cout) > 0 ? 1 : 0;
+    }
+
+    SetTiming(timings);
+    int mismatches = check ? Checks::FlattenOnAdd(seed, 10000, cout) + Checks::EventsBounded(seed, cout) : 0;
+    vector<BenchmarkResult> results;
+    // fullPath is where document was read from if it is a file
+    auto run = [&](const string &name, const string &language, const string &document, const string &fullPath)
+    {
+        if(check)
+        {
+            mismatches += Checks::Document(name, language, document, fullPath, cout);
+        }
+        else
+        {
+            results.push_back(Benchmark::Run(name, language, document, runs, useArena, flatAst, validate, events));
+        }
+    };
+
+    for(const auto &file : corpusFiles)
+    {
+        string document;
+        if(!ReadFile(corpus + "/" + file[0], document))
+        {
+            fprintf(stdout, "can't read '%s/%s'\r\n", corpus.c_str(), file[0]);
+            return 2;
+        }
+
+        run(string(file[1]) + "/" + file[0], file[1], document, corpus + "/" + file[0]);
+    }
+
+    stringstream shapeList(shapes);
+    string shapeName;
+    while(getline(shapeList, shapeName, ','))
+    {
+        DocumentShape shape;
+        if(!DocumentGenerator::ParseShape(shapeName, shape))
+        {
+            return Usage();
+        }
+
+        stringstream sizeList(sizes);
+        string size;
+        while(getline(sizeList, size, ','))
+        {
+            for(const string language : { "xml", "html", "css" })
+            {
+                DocumentGenerator generator(seed);
+                generator.maxDepth(depth);
+                string document = generator.Generate(language, shape, DocumentGenerator::ParseSize(size));
+                run(language + "/" + shapeName + "/" + size, language, document, "");
+            }
+        }
+    }
+
+    if(check)
+    {
+        fprintf(stdout, "%d mismatches\r\n", mismatches);
+        return mismatches > 0 ? 1 : 0;
+    }
+
+    Benchmark::WriteTable(results, cout);
+    if(timings)
+    {
+        fprintf(stdout, "\r\n%s", NanoTrace::Global().TimingReport().c_str());
+    }
+
+    if(jsonPath.size() > 0)
+    {
+        ofstream json(jsonPath, ios::binary);
+        Benchmark::WriteJson(results, json);
+        if(!json.good())
+        {
+            fprintf(stdout, "can't write '%s'\r\n", jsonPath.c_str());
+            return 2;
+        }
+    }
+
+    for(const BenchmarkResult &result : results)
+    {
+        if(!result.succeeded)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,482 @@
+#include "Benchmark.h"
+#include "FXPlatform/Parser/Compiler.h"
+#include "FXPlatform/Languages/CssParser.h"
+#include "FXPlatform/Languages/XmlCompiler.h"
+#include "FXPlatform/Languages/XmlEventCompiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+using namespace std;
+
+namespace
+{
+    long long CountNodes(const vector<shared_ptr<Symbol>> &symbols)
+    {
+        long long count = 0;
+        for(const shared_ptr<Symbol> &symbol : symbols)
+        {
+            count += 1 + CountNodes(symbol->children());
+        }
+
+        return count;
+    }
+
+    template<class Parser>
+    class CountingCompiler : public Compiler<Parser>
+    {
+    public:
+        CountingCompiler() : m_nodes(0) {}
+
+    protected:
+        virtual bool ProcessAst(shared_ptr<typename CountingCompiler::CompileResultType> ast)
+        {
+            m_nodes = CountNodes(*ast);
+            return true;
+        }
+
+        virtual bool ProcessFlatAst(shared_ptr<FlatAst> ast)
+        {
+            m_nodes = ast->size();
+            return true;
+        }
+
+        // When events() is set
+        virtual void Enter(unsigned short /* symbolID */, long /* start */) { ++m_nodes; }
+        virtual void Token(unsigned short /* symbolID */, FlattenType /* flattenType */, long /* start */, long /* length */, const string & /* text */) { ++m_nodes; }
+
+        ValueProperty(private, long long, nodes);
+    };
+
+    // Also builds the XmlNodes since that is part of what compiling XML costs
+    class CountingXmlCompiler : public XmlCompiler
+    {
+    public:
+        CountingXmlCompiler() : m_nodes(0) {}
+
+        virtual bool ProcessAst(shared_ptr<CompileResultType> ast)
+        {
+            m_nodes = CountNodes(*ast);
+            return XmlCompiler::ProcessAst(ast);
+        }
+
+        virtual bool ProcessFlatAst(shared_ptr<FlatAst> ast)
+        {
+            m_nodes = ast->size();
+            return XmlCompiler::ProcessFlatAst(ast);
+        }
+
+        ValueProperty(private, long long, nodes);
+    };
+
+    class CountingXmlEventCompiler : public XmlEventCompiler
+    {
+    public:
+        CountingXmlEventCompiler() : m_nodes(0) {}
+
+        ValueProperty(private, long long, nodes);
+
+    protected:
+        virtual void Enter(unsigned short symbolID, long start)
+        {
+            ++m_nodes;
+            XmlEventCompiler::Enter(symbolID, start);
+        }
+
+        virtual void Token(unsigned short symbolID, FlattenType flattenType, long start, long length, const string &text)
+        {
+            ++m_nodes;
+            XmlEventCompiler::Token(symbolID, flattenType, start, length, text);
+        }
+    };
+
+    template<class CompilerType>
+    bool CompileOnce(const string &document, shared_ptr<SymbolArena> arena, bool flatAst, bool validate, bool events, long long &nodes)
+    {
+        CompilerType compiler;
+        compiler.arena(arena);
+        compiler.flatAst(flatAst);
+        compiler.events(events);
+        shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
+        lexer->Open(document.data(), (long) document.size(), nullptr);
+        bool succeeded = validate ? compiler.Validate(lexer) : compiler.Compile(lexer);
+        nodes = compiler.nodes();
+        return succeeded;
+    }
+
+    bool Compile(const string &language, const string &document, shared_ptr<SymbolArena> arena, bool flatAst, bool validate, bool events, long long &nodes)
+    {
+        if(language == "xml" && events)
+        {
+            return CompileOnce<CountingXmlEventCompiler>(document, arena, flatAst, validate, events, nodes);
+        }
+        else if(language == "xml")
+        {
+            return CompileOnce<CountingXmlCompiler>(document, arena, flatAst, validate, events, nodes);
+        }
+        else if(language == "html")
+        {
+            return CompileOnce<CountingCompiler<Html::HtmlDocumentRule>>(document, arena, flatAst, validate, events, nodes);
+        }
+        else
+        {
+            return CompileOnce<CountingCompiler<Html::CssDocument>>(document, arena, flatAst, validate, events, nodes);
+        }
+    }
+
+    string JsonString(const string &value)
+    {
+        string result = "\"";
+        for(char character : value)
+        {
+            if(character == '"' || character == '\\')
+            {
+                result += '\\';
+            }
+
+            result += character;
+        }
+
+        return result + "\"";
+    }
+
+    // Percent that current changed from baseline, 0 if there is no baseline to compare to
+    double PercentChange(double baseline, double current)
+    {
+        return baseline == 0 ? 0 : (current - baseline) / baseline * 100;
+    }
+
+    void SkipWhitespace(const string &json, size_t &position)
+    {
+        while(position < json.size() && isspace((unsigned char) json[position]))
+        {
+            ++position;
+        }
+    }
+
+    bool ReadJsonString(const string &json, size_t &position, string &value)
+    {
+        if(position >= json.size() || json[position] != '"')
+        {
+            return false;
+        }
+
+        value.clear();
+        for(++position; position < json.size() && json[position] != '"'; ++position)
+        {
+            if(json[position] == '\\' && position + 1 < json.size())
+            {
+                ++position;
+            }
+
+            value += json[position];
+        }
+
+        return position++ < json.size();
+    }
+
+    // Reads one result written by WriteJson()
+    bool ReadJsonResult(const string &json, size_t &position, BenchmarkResult &result)
+    {
+        ++position;
+        while(true)
+        {
+            SkipWhitespace(json, position);
+            string key;
+            if(!ReadJsonString(json, position, key))
+            {
+                return false;
+            }
+
+            SkipWhitespace(json, position);
+            if(position >= json.size() || json[position++] != ':')
+            {
+                return false;
+            }
+
+            SkipWhitespace(json, position);
+            string text;
+            double number = 0;
+            if(position < json.size() && json[position] == '"')
+            {
+                if(!ReadJsonString(json, position, text))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                size_t end = json.find_first_of(",} \t\r\n", position);
+                if(end == string::npos)
+                {
+                    return false;
+                }
+
+                text = json.substr(position, end - position);
+                number = atof(text.c_str());
+                position = end;
+            }
+
+            if(key == "name") { result.name = text; }
+            else if(key == "language") { result.language = text; }
+            else if(key == "bytes") { result.bytes = (long long) number; }
+            else if(key == "nodes") { result.nodes = (long long) number; }
+            else if(key == "seconds") { result.seconds = number; }
+            else if(key == "mbPerSecond") { result.mbPerSecond = number; }
+            else if(key == "nodesPerSecond") { result.nodesPerSecond = number; }
+            else if(key == "allocationsPerKB") { result.allocationsPerKB = number; }
+            else if(key == "peakRssKB") { result.peakRssKB = (long long) number; }
+            else if(key == "succeeded") { result.succeeded = text == "true"; }
+
+            SkipWhitespace(json, position);
+            if(position >= json.size())
+            {
+                return false;
+            }
+            else if(json[position] == '}')
+            {
+                ++position;
+                return true;
+            }
+            else if(json[position++] != ',')
+            {
+                return false;
+            }
+        }
+    }
+}
+
+int Benchmark::Compare(const vector<BenchmarkResult> &baseline, const vector<BenchmarkResult> &current, double thresholdPercent, ostream &stream)
+{
+    int regressions = 0;
+    stream << left << setw(32) << "Benchmark" << right << setw(12) << "Base MB/s" << setw(12) << "MB/s" << setw(10) << "Change"
+        << setw(12) << "Allocs/KB" << setw(10) << "Change" << setw(12) << "Peak RSS" << setw(10) << "Change" << "\r\n";
+    for(const BenchmarkResult &result : current)
+    {
+        vector<BenchmarkResult>::const_iterator found = find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult &item) { return item.name == result.name; });
+        if(found == baseline.end())
+        {
+            stream << left << setw(32) << result.name << right << "  (not in baseline)\r\n";
+            continue;
+        }
+
+        double speedChange = PercentChange(found->mbPerSecond, result.mbPerSecond);
+        double allocationChange = PercentChange(found->allocationsPerKB, result.allocationsPerKB);
+        // 0 when it couldn't be measured
+        double memoryChange = found->peakRssKB == 0 || result.peakRssKB == 0 ? 0 : PercentChange((double) found->peakRssKB, (double) result.peakRssKB);
+        string problems;
+        if(found->succeeded && !result.succeeded) { problems += " FAILED"; }
+        if(speedChange < -thresholdPercent) { problems += " SLOWER"; }
+        if(allocationChange > thresholdPercent) { problems += " ALLOCATIONS"; }
+        if(memoryChange > thresholdPercent) { problems += " MEMORY"; }
+
+        stream << left << setw(32) << result.name << right << fixed << setprecision(2)
+            << setw(12) << found->mbPerSecond << setw(12) << result.mbPerSecond << setw(9) << speedChange << "%"
+            << setw(12) << result.allocationsPerKB << setw(9) << allocationChange << "%"
+            << setw(12) << result.peakRssKB << setw(9) << memoryChange << "%";
+        if(problems.size() > 0)
+        {
+            ++regressions;
+            stream << "  REGRESSION:" << problems;
+        }
+
+        stream << "\r\n";
+    }
+
+    for(const BenchmarkResult &result : baseline)
+    {
+        if(find_if(current.begin(), current.end(), [&](const BenchmarkResult &item) { return item.name == result.name; }) == current.end())
+        {
+            stream << left << setw(32) << result.name << right << "  (missing from this run)\r\n";
+        }
+    }
+
+    stream << regressions << " regression(s) beyond " << thresholdPercent << "%\r\n";
+    return regressions;
+}
+
+long long Benchmark::PeakRssKB()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+
+    return (long long) (counters.PeakWorkingSetSize / 1024);
+#elif defined(__linux__)
+    // VmHWM is what ResetPeakRss() resets, ru_maxrss isn't
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line))
+    {
+        if(line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return atoll(line.c_str() + 6);
+        }
+    }
+
+    return 0;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+#if defined(__APPLE__)
+    // In bytes on macOS and KB everywhere else
+    return (long long) usage.ru_maxrss / 1024;
+#else
+    return (long long) usage.ru_maxrss;
+#endif
+#endif
+}
+
+bool Benchmark::ResetPeakRss()
+{
+#if defined(__linux__)
+#if defined(__GLIBC__)
+    // Otherwise what earlier benchmarks freed is still resident and counts as what this one is using
+    malloc_trim(0);
+#endif
+    // "5" resets the peak resident set size to the current one
+    ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+#else
+    return false;
+#endif
+}
+
+bool Benchmark::ReadJson(const string &fullPath, vector<BenchmarkResult> &results, string &error)
+{
+    ifstream file(fullPath, ios::binary);
+    if(!file.good())
+    {
+        error = "can't open '" + fullPath + "'";
+        return false;
+    }
+
+    stringstream contents;
+    contents << file.rdbuf();
+    string json = contents.str();
+
+    size_t position = json.find("\"results\"");
+    position = position == string::npos ? string::npos : json.find('[', position);
+    if(position == string::npos)
+    {
+        error = "'" + fullPath + "' doesn't have any results";
+        return false;
+    }
+
+    ++position;
+    while(true)
+    {
+        SkipWhitespace(json, position);
+        if(position < json.size() && json[position] == ']')
+        {
+            return true;
+        }
+        else if(position < json.size() && json[position] == ',')
+        {
+            ++position;
+            continue;
+        }
+
+        BenchmarkResult result;
+        if(position >= json.size() || json[position] != '{' || !ReadJsonResult(json, position, result))
+        {
+            error = "'" + fullPath + "' isn't a results file, error at " + lexical_cast<string>(position);
+            return false;
+        }
+
+        results.push_back(result);
+    }
+}
+
+BenchmarkResult Benchmark::Run(const string &name, const string &language, const string &document, int runs, bool useArena, bool flatAst, bool validate, bool events)
+{
+    // One arena for all the runs, the way a long running process would use it
+    shared_ptr<SymbolArena> arena = useArena ? shared_ptr<SymbolArena>(new SymbolArena()) : nullptr;
+    BenchmarkResult result;
+    result.name = name;
+    result.language = language;
+    result.bytes = (long long) document.size();
+
+    // The peak memory is otherwise whatever the biggest benchmark so far used
+    bool measureMemory = ResetPeakRss();
+
+    // The first run warms up the caches and the allocator, and the static tables in the rules
+    long long nodes = 0;
+    result.succeeded = Compile(language, document, arena, flatAst, validate, events, nodes);
+
+    vector<double> times;
+    for(int run = 0; run < runs; ++run)
+    {
+        long long allocationsBefore = allocations();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Compile(language, document, arena, flatAst, validate, events, nodes);
+        times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        if(run == 0)
+        {
+            result.allocationsPerKB = result.bytes == 0 ? 0 : (double) (allocations() - allocationsBefore) / ((double) result.bytes / 1024);
+        }
+    }
+
+    sort(times.begin(), times.end());
+    result.seconds = times.size() == 0 ? 0 : times[times.size() / 2];
+    result.nodes = nodes;
+    result.mbPerSecond = result.seconds == 0 ? 0 : (double) result.bytes / (1024 * 1024) / result.seconds;
+    result.nodesPerSecond = result.seconds == 0 ? 0 : (double) nodes / result.seconds;
+    result.peakRssKB = measureMemory ? PeakRssKB() : 0;
+    return result;
+}
+
+void Benchmark::WriteJson(const vector<BenchmarkResult> &results, ostream &stream)
+{
+    stream << "{\n  \"results\": [\n";
+    for(size_t index = 0; index < results.size(); ++index)
+    {
+        const BenchmarkResult &result = results[index];
+        stream << "    {" << setprecision(6) << fixed
+            << "\"name\": " << JsonString(result.name)
+            << ", \"language\": " << JsonString(result.language)
+            << ", \"bytes\": " << result.bytes
+            << ", \"nodes\": " << result.nodes
+            << ", \"seconds\": " << result.seconds
+            << ", \"mbPerSecond\": " << result.mbPerSecond
+            << ", \"nodesPerSecond\": " << result.nodesPerSecond
+            << ", \"allocationsPerKB\": " << result.allocationsPerKB
+            << ", \"peakRssKB\": " << result.peakRssKB
+            << ", \"succeeded\": " << (result.succeeded ? "true" : "false")
+            << "}" << (index + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    stream << "  ]\n}\n";
+}
+
+void Benchmark::WriteTable(const vector<BenchmarkResult> &results, ostream &stream)
+{
+    stream << left << setw(32) << "Benchmark" << right << setw(12) << "Bytes" << setw(10) << "OK" << setw(12) << "ms"
+        << setw(10) << "MB/s" << setw(14) << "Nodes/s" << setw(12) << "Allocs/KB" << setw(12) << "Peak RSS" << "\r\n";
+    for(const BenchmarkResult &result : results)
+    {
+        stream << left << setw(32) << result.name << right << fixed << setprecision(2) << setw(12) << result.bytes << setw(10) << (result.succeeded ? "yes" : "FAILED")
+            << setw(12) << result.seconds * 1000 << setw(10) << result.mbPerSecond << setw(14) << setprecision(0) << result.nodesPerSecond
+            << setw(12) << setprecision(2) << result.allocationsPerKB << setw(12) << (result.peakRssKB == 0 ? string("-") : lexical_cast<string>(result.peakRssKB) + "KB") << "\r\n";
+    }
+}
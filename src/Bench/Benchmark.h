@@ -0,0 +1,66 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How one compiler did parsing one document, the median of several runs
+class BenchmarkResult
+{
+public:
+    BenchmarkResult() :
+        allocationsPerKB(0),
+        bytes(0),
+        mbPerSecond(0),
+        nodes(0),
+        nodesPerSecond(0),
+        peakRssKB(0),
+        seconds(0),
+        succeeded(false)
+    {
+    }
+
+    double allocationsPerKB;
+    long long bytes;
+    // "xml", "html" or "css"
+    std::string language;
+    double mbPerSecond;
+    // Unique within a run, used to match results when comparing runs
+    std::string name;
+    // Symbols in the tree that was parsed
+    long long nodes;
+    double nodesPerSecond;
+    // The most memory the process used while the benchmark ran. 0 where it can't be measured, see Benchmark::ResetPeakRss()
+    long long peakRssKB;
+    double seconds;
+    bool succeeded;
+};
+
+// Measures how fast the compilers parse documents, see BenchMain.cpp
+class Benchmark
+{
+public:
+    // Counted by the operator new in BenchMain.cpp
+    static long long allocations();
+
+    // Compiles document runs times with the compiler for language (after one run to warm up) and reports the median time
+    // useArena allocates the Symbols from a SymbolArena, flatAst has the compilers process a FlatAst instead of the Symbols
+    // and validate only checks that the document parses (nodes is 0 since there is no tree). events has the compilers get the tree as
+    // it is parsed (see ParseEventHandler), XML uses XmlEventCompiler
+    static BenchmarkResult Run(const std::string &name, const std::string &language, const std::string &document, int runs, bool useArena = false, bool flatAst = false, 
+        bool validate = false, bool events = false);
+
+    // Writes results out as JSON and reads them back in. ReadJson() only reads what WriteJson() writes
+    static void WriteJson(const std::vector<BenchmarkResult> &results, std::ostream &stream);
+    static bool ReadJson(const std::string &fullPath, std::vector<BenchmarkResult> &results, std::string &error);
+    static void WriteTable(const std::vector<BenchmarkResult> &results, std::ostream &stream);
+
+    // Writes how each result in current changed since baseline and returns how many regressed by more than thresholdPercent:
+    // slower, more allocations, more memory or failing where it used to succeed
+    static int Compare(const std::vector<BenchmarkResult> &baseline, const std::vector<BenchmarkResult> &current, double thresholdPercent, std::ostream &stream);
+
+    // The most memory the process has used since it started or since ResetPeakRss() was last called
+    static long long PeakRssKB();
+    // Sets what PeakRssKB() returns back to the memory the process is using now. Only Linux can do this (by writing to 
+    // /proc/self/clear_refs), returns false everywhere else
+    static bool ResetPeakRss();
+};
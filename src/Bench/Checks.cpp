@@ -0,0 +1,392 @@
+#include "Checks.h"
+#include "DocumentGenerator.h"
+#include "FXPlatform/Parser/Compiler.h"
+#include "FXPlatform/Parser/SymbolArena.h"
+#include "FXPlatform/Languages/CssParser.h"
+#include "FXPlatform/Languages/HtmlParser.h"
+#include "FXPlatform/Languages/XmlCompiler.h"
+#include "FXPlatform/Languages/XmlEventCompiler.h"
+#include <sstream>
+#include <vector>
+using namespace FXPlat;
+using namespace std;
+
+namespace
+{
+    // A tree for FlattenOnAdd() to build. Leaves with text become TokenSymbols
+    class TreeSpec
+    {
+    public:
+        TreeSpec(unsigned short symbolID, FlattenType flattenType) :
+            flattenType(flattenType),
+            symbolID(symbolID)
+        {
+        }
+
+        vector<TreeSpec> children;
+        FlattenType flattenType;
+        unsigned short symbolID;
+        string text;
+    };
+
+    // Same generator as DocumentGenerator so the trees are the same on every platform
+    class Random
+    {
+    public:
+        Random(unsigned int seed) :
+            m_state(seed)
+        {
+        }
+
+        unsigned int Next(unsigned int count)
+        {
+            m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return (unsigned int) (m_state >> 33) % count;
+        }
+
+    private:
+        unsigned long long m_state;
+    };
+
+    TreeSpec RandomTree(Random &random, int depth)
+    {
+        static const FlattenType flattenTypes[] = { FlattenType::None, FlattenType::Flatten, FlattenType::Delete };
+        if(depth > 0 && random.Next(4) == 0)
+        {
+            TreeSpec leaf(256 + random.Next(8), FlattenType::Token);
+            leaf.text = string(1 + random.Next(3), (char) ('a' + random.Next(26)));
+            return leaf;
+        }
+
+        TreeSpec tree(256 + random.Next(8), flattenTypes[random.Next(3)]);
+        int childCount = depth < 5 ? (int) random.Next(4) : 0;
+        for(int index = 0; index < childCount; ++index)
+        {
+            tree.children.push_back(RandomTree(random, depth + 1));
+        }
+
+        return tree;
+    }
+
+    // The children are added once they are built, the way the rules do it
+    shared_ptr<Symbol> BuildTree(const TreeSpec &tree)
+    {
+        if(tree.text.size() > 0)
+        {
+            return shared_ptr<Symbol>(new TokenSymbol(tree.symbolID, 0, tree.text.c_str(), (long) tree.text.size(), nullptr));
+        }
+
+        shared_ptr<Symbol> symbol = shared_ptr<Symbol>(new Symbol(tree.symbolID, tree.flattenType));
+        for(const TreeSpec &child : tree.children)
+        {
+            symbol->AddSubsymbol(BuildTree(child));
+        }
+
+        return symbol;
+    }
+
+    // Writes the IDs and the structure of the tree and the text of the leaves. ParserDebug::PrintTree() writes the text of every
+    // node which takes far too long for big documents
+    void Describe(Symbol *symbol, string &description)
+    {
+        description += "(" + lexical_cast<string>(symbol->symbolID()) + (symbol->children().size() == 0 ? " " + symbol->ToString() : "");
+        for(const shared_ptr<Symbol> &child : symbol->children())
+        {
+            Describe(child.get(), description);
+        }
+
+        description += ")";
+    }
+
+    // What the whole tree pass used to make out of tree, written the same way Describe() writes Symbols
+    void DescribeTwoPass(const TreeSpec &tree, string &description)
+    {
+        switch(tree.flattenType)
+        {
+        case FlattenType::None:
+        case FlattenType::Token:
+        {
+            // It removed the children that were deleted and replaced the flattened ones with their own children
+            string children;
+            for(const TreeSpec &child : tree.children)
+            {
+                DescribeTwoPass(child, children);
+            }
+
+            description += "(" + lexical_cast<string>(tree.symbolID) + (children.size() == 0 ? " " + tree.text : children) + ")";
+        }
+            break;
+        case FlattenType::Delete:
+            break;
+        case FlattenType::Flatten:
+            for(const TreeSpec &child : tree.children)
+            {
+                DescribeTwoPass(child, description);
+            }
+            break;
+        }
+    }
+
+    // Same as Describe() for a FlatAst
+    void DescribeFlat(FlatAstCursor node, string &description)
+    {
+        description += "(" + lexical_cast<string>(node.symbolID()) + (node.childCount() == 0 ? " " + node.ToString() : "");
+        for(FlatAstCursor child = node.firstChild(); child.valid(); child = child.nextSibling())
+        {
+            DescribeFlat(child, description);
+        }
+
+        description += ")";
+    }
+
+    // The ways Document() compiles a document
+    enum class Mode
+    {
+        Events,
+        FlatAst,
+        Memoize,
+        Plain,
+        Stream,
+        Validate
+    };
+
+    // What one way of compiling a document got
+    class Outcome
+    {
+    public:
+        string errors;
+        // The events for the tree, see RecordingCompiler
+        string events;
+        bool succeeded;
+        // What the compiler was handed, written by Describe()
+        string tree;
+    };
+
+    // Writes down the tree it gets. If it gets Symbols it also sends them to itself as events (see ParseEventHandler::Send())
+    // so they can be compared with the events it gets when events() is set
+    template<class Parser>
+    class RecordingCompiler : public Compiler<Parser>
+    {
+    public:
+        stringstream eventLog;
+        string tree;
+
+    protected:
+        virtual bool ProcessAst(shared_ptr<typename RecordingCompiler::CompileResultType> ast)
+        {
+            long position = 0;
+            for(const shared_ptr<Symbol> &symbol : *ast)
+            {
+                Describe(symbol.get(), tree);
+                this->Send(symbol.get(), position);
+            }
+
+            return true;
+        }
+
+        virtual bool ProcessFlatAst(shared_ptr<FlatAst> ast)
+        {
+            for(FlatAstCursor node = ast->root(); node.valid(); node = node.nextSibling())
+            {
+                DescribeFlat(node, tree);
+            }
+
+            return true;
+        }
+
+        virtual void Enter(unsigned short symbolID, long start)
+        {
+            eventLog << "E" << symbolID << "@" << start << " ";
+        }
+
+        virtual void Leave(unsigned short symbolID, long start, long length)
+        {
+            eventLog << "L" << symbolID << "@" << start << "," << length << " ";
+        }
+
+        virtual void Token(unsigned short symbolID, FlattenType flattenType, long start, long length, const string &text)
+        {
+            eventLog << "T" << symbolID << (flattenType == FlattenType::Token ? "t@" : "@") << start << "," << length << "[" << text << "] ";
+        }
+    };
+
+    template<class Parser>
+    Outcome CompileDocument(const string &document, Mode mode)
+    {
+        RecordingCompiler<Parser> compiler;
+        Outcome outcome;
+        switch(mode)
+        {
+        case Mode::Events:
+            compiler.events(true);
+            outcome.succeeded = compiler.Compile(document);
+            break;
+        case Mode::FlatAst:
+            compiler.flatAst(true);
+            outcome.succeeded = compiler.Compile(document);
+            break;
+        case Mode::Memoize:
+            compiler.memoize(true);
+            outcome.succeeded = compiler.Compile(document);
+            break;
+        case Mode::Plain:
+            outcome.succeeded = compiler.Compile(document);
+            break;
+        case Mode::Stream:
+            outcome.succeeded = compiler.Compile(shared_ptr<istream>(new stringstream(document)));
+            break;
+        case Mode::Validate:
+            outcome.succeeded = compiler.Validate(document);
+            break;
+        }
+
+        outcome.errors = compiler.GetErrorString();
+        outcome.events = compiler.eventLog.str();
+        outcome.tree = compiler.tree;
+        return outcome;
+    }
+
+    // Compiles the file with CompileDocument(), memory mapping it if mapped is set and reading it through a stream if not
+    template<class Parser>
+    Outcome CompileFile(const string &fullPath, bool mapped)
+    {
+        RecordingCompiler<Parser> compiler;
+        compiler.mappedFileThreshold(mapped ? 0 : -1);
+        Outcome outcome;
+        outcome.succeeded = compiler.CompileDocument(fullPath);
+        outcome.errors = compiler.GetErrorString();
+        outcome.events = compiler.eventLog.str();
+        outcome.tree = compiler.tree;
+        return outcome;
+    }
+
+    // Returns 1 and writes what is different if outcome doesn't match plain. The tree and the events are only compared if
+    // compareTree and compareEvents are set, and the events only if the document parsed since the ones already sent are kept
+    int Compare(const string &name, const string &modeName, const Outcome &plain, const Outcome &outcome, bool compareTree, bool compareEvents, 
+        ostream &stream)
+    {
+        if(outcome.succeeded != plain.succeeded)
+        {
+            stream << name << ": " << modeName << (outcome.succeeded ? " succeeded" : " failed") << " but compiling didn't\r\n";
+        }
+        else if(outcome.errors != plain.errors)
+        {
+            stream << name << ": " << modeName << " failed with '" << outcome.errors << "' instead of '" << plain.errors << "'\r\n";
+        }
+        else if(compareTree && outcome.tree != plain.tree)
+        {
+            stream << name << ": " << modeName << " made a different tree\r\n";
+        }
+        else if(compareEvents && plain.succeeded && outcome.events != plain.events)
+        {
+            stream << name << ": " << modeName << " sent different events\r\n";
+        }
+        else
+        {
+            return 0;
+        }
+
+        return 1;
+    }
+
+    template<class Parser>
+    int CheckDocument(const string &name, const string &document, const string &fullPath, ostream &stream)
+    {
+        Outcome plain = CompileDocument<Parser>(document, Mode::Plain);
+        int mismatches = 0;
+        mismatches += Compare(name, "validating", plain, CompileDocument<Parser>(document, Mode::Validate), false, false, stream);
+        mismatches += Compare(name, "events", plain, CompileDocument<Parser>(document, Mode::Events), false, true, stream);
+        mismatches += Compare(name, "flatAst", plain, CompileDocument<Parser>(document, Mode::FlatAst), true, false, stream);
+        mismatches += Compare(name, "memoizing", plain, CompileDocument<Parser>(document, Mode::Memoize), true, false, stream);
+        mismatches += Compare(name, "streaming", plain, CompileDocument<Parser>(document, Mode::Stream), true, false, stream);
+        if(fullPath.size() > 0)
+        {
+            mismatches += Compare(name, "the mapped file", plain, CompileFile<Parser>(fullPath, true), true, false, stream);
+            mismatches += Compare(name, "the file stream", plain, CompileFile<Parser>(fullPath, false), true, false, stream);
+        }
+
+        return mismatches;
+    }
+}
+
+int Checks::FlattenOnAdd(unsigned int seed, int trees, ostream &stream)
+{
+    Random random(seed);
+    int mismatches = 0;
+    for(int index = 0; index < trees; ++index)
+    {
+        TreeSpec tree = RandomTree(random, 0);
+        vector<shared_ptr<Symbol>> flattened;
+        BuildTree(tree)->FlattenInto(flattened);
+        string onAdd;
+        for(const shared_ptr<Symbol> &symbol : flattened)
+        {
+            Describe(symbol.get(), onAdd);
+        }
+
+        string twoPass;
+        DescribeTwoPass(tree, twoPass);
+        if(onAdd != twoPass)
+        {
+            stream << "flatten on add, tree " << index << ": " << onAdd << " but the whole tree pass makes " << twoPass << "\r\n";
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+int Checks::Document(const string &name, const string &language, const string &document, const string &fullPath, ostream &stream)
+{
+    if(language == "css")
+    {
+        return CheckDocument<Html::CssDocument>(name, document, fullPath, stream);
+    }
+
+    int mismatches = CheckDocument<Html::HtmlDocumentRule>(name, document, fullPath, stream);
+    if(language == "xml")
+    {
+        // XmlEventCompiler can add more errors after the parse error, so only the XmlNodes are compared
+        XmlCompiler compiler;
+        XmlEventCompiler eventCompiler;
+        bool succeeded = compiler.Compile(document);
+        if(eventCompiler.Compile(document) != succeeded || (succeeded && eventCompiler.result()->ToString() != compiler.result()->ToString()))
+        {
+            stream << name << ": XmlEventCompiler didn't make the same XmlNodes as XmlCompiler\r\n";
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+int Checks::EventsBounded(unsigned int seed, ostream &stream)
+{
+    // The arena never gives its blocks back, so with small blocks how many it ends up with is close to the most Symbols that
+    // were alive at once
+    static const size_t blockSize = 4 * 1024;
+    const long long sizes[] = { 64 * 1024, 1024 * 1024 };
+    size_t blocks[2];
+    for(int index = 0; index < 2; ++index)
+    {
+        DocumentGenerator generator(seed);
+        string document = generator.Generate("xml", DocumentShape::Wide, sizes[index]);
+        XmlEventCompiler compiler;
+        compiler.arena(shared_ptr<SymbolArena>(new SymbolArena(blockSize)));
+        if(!compiler.Compile(document))
+        {
+            stream << "events bounded: xml/wide/" << sizes[index] / 1024 << "K failed with '" << compiler.GetErrorString() << "'\r\n";
+            return 1;
+        }
+
+        blocks[index] = compiler.arena()->blockCount();
+    }
+
+    if(blocks[1] > blocks[0])
+    {
+        stream << "events bounded: xml/wide/1024K needed " << blocks[1] << " blocks of Symbols but xml/wide/64K only needed " << blocks[0] << "\r\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+// Checks that the different ways of building the same tree agree with each other, see indparse_bench --check. Each check writes
+// a line to stream for every mismatch it finds and returns how many it found
+class Checks
+{
+public:
+    // Builds trees by hand out of Symbols with random FlattenTypes and checks that flattening them as they are built (see
+    // Symbol::AddSubsymbol()) makes the same tree as flattening the whole tree afterwards the way FlattenInto() used to
+    static int FlattenOnAdd(unsigned int seed, int trees, std::ostream &stream);
+    // Compiles document (language is "xml", "html" or "css") the plain way and then in each of the other modes and checks they
+    // get the same result: Validate() succeeds or fails with the same errors, events() sends the same events as the finished tree
+    // and flatAst() and memoize() hand over the same tree, and so does reading it from a stream. If fullPath is the file document
+    // was read from, it is also compiled with CompileDocument() both memory mapped and through a stream. XML is also compiled with
+    // XmlEventCompiler which has to make the same XmlNodes
+    static int Document(const std::string &name, const std::string &language, const std::string &document, const std::string &fullPath,
+        std::ostream &stream);
+    // Compiles a wide XML document and one sixteen times bigger with XmlEventCompiler and checks that the parser didn't need any more
+    // memory for the Symbols of the big one: each element is sent once its start tag is parsed (see CutExpression) so only the
+    // Symbols for the open elements are alive at once, no matter how many children they have
+    static int EventsBounded(unsigned int seed, std::ostream &stream);
+};
@@ -0,0 +1,599 @@
+#include "DocumentGenerator.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+using namespace std;
+
+namespace
+{
+    const char *words[] =
+    {
+        "parser", "symbol", "rule", "lexer", "token", "tree", "grammar", "expression", "character", "document",
+        "element", "attribute", "value", "stream", "template", "memo", "flatten", "compile", "error", "node",
+        "a", "an", "the", "of", "to", "and", "is", "in", "it", "was"
+    };
+
+    const char *punctuation[] = { ".", ",", "!", "?", ";", ":", "&", " -" };
+
+    const char *cssProperties[] =
+    {
+        "margin", "padding", "color", "background-color", "font-family", "font-size", "width", "height", "border", "text-decoration"
+    };
+
+    const char *cssIdentifiers[] = { "bold", "none", "solid", "auto", "inherit", "underline", "center", "sans-serif" };
+    const char *cssUnits[] = { "px", "pt", "%", "em" };
+    const char *cssPseudoClasses[] = { ":hover", ":first-child", ":visited", "::before", "::after" };
+    // Identifiers that start like url(...) and rgba(...) values so those rules get partway in before they fail
+    const char *cssNearMissIdentifiers[] = { "urlencoded", "url-like", "rgbafallback", "rgba-like", "em-dash", "px_ratio" };
+
+    // Tags with children and tags with only text, for Typical documents
+    const char *containerTags[] = { "div", "ul", "table", "section" };
+    const char *childTags[][2] = { { "div", "div" }, { "ul", "li" }, { "table", "tr" }, { "section", "p" } };
+    const char *textTags[] = { "p", "span", "b", "i", "em", "h1", "td", "title" };
+
+    // Start with "style" so the style element rule reads all the way to the first "</style" before it fails
+    const char *styleNearMissTags[] = { "styled", "styles", "stylist" };
+
+    template<size_t count>
+    const char *Choose(const char *(&list)[count], unsigned int index)
+    {
+        return list[index % count];
+    }
+}
+
+void DocumentGenerator::AddAttribute(string &document, bool xml)
+{
+    // Empty attributes aren't XML
+    string name = string("data-") + Choose(words, Random(30)) + lexical_cast<string>(Random(100));
+    switch(Random(xml ? 2 : 4))
+    {
+        case 0:
+            document += " " + name + "=\"";
+            AddWord(document);
+            document += " ";
+            AddWord(document);
+            document += "\"";
+            break;
+        case 1:
+            document += " " + name + "='";
+            AddWord(document);
+            document += "'";
+            break;
+        case 2:
+            document += " " + name + "=";
+            AddWord(document);
+            break;
+        default:
+            document += " " + name;
+            break;
+    }
+}
+
+void DocumentGenerator::AddCssDeclaration(string &document, bool nearMiss)
+{
+    document += Choose(cssProperties, Random(10));
+    document += nearMiss ? "/**/ : /* value */" : ": ";
+    int values = 1 + Random(3);
+    for(int index = 0; index < values; ++index)
+    {
+        if(index > 0)
+        {
+            document += Random(2) == 0 ? " " : ", ";
+        }
+
+        if(nearMiss)
+        {
+            switch(Random(4))
+            {
+                case 0:
+                    // Only matched after the url and rgba rules have both read some of it
+                    document += Choose(cssNearMissIdentifiers, Random(6));
+                    break;
+                case 1:
+                    // Read as the number in a length before failing to find a unit. Doesn't start with "0." since the length rule
+                    // matches that as a unitless zero and then the declaration fails
+                    document += lexical_cast<string>(1 + Random(999)) + "." + lexical_cast<string>(Random(100000));
+                    break;
+                case 2:
+                    document += "0";
+                    break;
+                default:
+                    document += "'";
+                    AddWord(document);
+                    document += "'";
+                    break;
+            }
+
+            continue;
+        }
+
+        switch(Random(10))
+        {
+            case 0:
+                document += "0";
+                break;
+            case 1:
+                document += lexical_cast<string>(Random(100)) + Choose(cssUnits, Random(4));
+                break;
+            case 2:
+                document += lexical_cast<string>(Random(10)) + "." + lexical_cast<string>(Random(10)) + Choose(cssUnits, Random(4));
+                break;
+            case 3:
+                document += Random(2) == 0 ? "#fff" : "#a0b1c2";
+                break;
+            case 4:
+                document += "rgba(" + lexical_cast<string>(Random(256)) + ", " + lexical_cast<string>(Random(256)) + ", " +
+                    lexical_cast<string>(Random(256)) + ", 0." + lexical_cast<string>(Random(10)) + ")";
+                break;
+            case 5:
+                document += Random(2) == 0 ? "url(\"images/a.png\")" : "url(images/b.png)";
+                break;
+            case 6:
+                document += lexical_cast<string>(Random(100));
+                break;
+            case 7:
+                document += "\"";
+                AddWord(document);
+                document += "\"";
+                break;
+            default:
+                document += Choose(cssIdentifiers, Random(8));
+                break;
+        }
+    }
+
+    document += ";";
+}
+
+void DocumentGenerator::AddCssRule(string &document, bool nearMiss)
+{
+    int selectors = 1 + Random(3);
+    for(int index = 0; index < selectors; ++index)
+    {
+        if(index > 0)
+        {
+            document += nearMiss ? " /* or */ , " : ", ";
+        }
+
+        AddCssSelector(document, 1 + Random(3));
+    }
+
+    document += " {";
+    int declarations = 1 + Random(6);
+    for(int index = 0; index < declarations; ++index)
+    {
+        document += nearMiss ? " /* next */ " : " ";
+        AddCssDeclaration(document, nearMiss);
+    }
+
+    document += " }";
+}
+
+void DocumentGenerator::AddCssSelector(string &document, int compounds)
+{
+    for(int index = 0; index < compounds; ++index)
+    {
+        if(index > 0)
+        {
+            document += " ";
+        }
+
+        switch(Random(5))
+        {
+            case 0:
+                document += ".";
+                AddWord(document);
+                break;
+            case 1:
+                document += "#";
+                AddWord(document);
+                break;
+            case 2:
+                document += Choose(cssPseudoClasses, Random(5));
+                break;
+            case 3:
+                document += "*";
+                break;
+            default:
+                document += Choose(textTags, Random(8));
+                break;
+        }
+
+        // Type and universal selectors can only come first
+        int more = Random(3);
+        for(int extra = 0; extra < more; ++extra)
+        {
+            switch(Random(3))
+            {
+                case 0:
+                    document += ".c" + lexical_cast<string>(Random(1000));
+                    break;
+                case 1:
+                    document += "#i" + lexical_cast<string>(Random(1000));
+                    break;
+                default:
+                    document += Choose(cssPseudoClasses, Random(5));
+                    break;
+            }
+        }
+    }
+}
+
+void DocumentGenerator::AddElement(string &document, bool xml, int depth)
+{
+    switch(Random(depth < 4 ? 8 : 4))
+    {
+        case 0:
+        {
+            const char *tag = Choose(textTags, Random(8));
+            document += string("<") + tag;
+            int attributes = Random(3);
+            for(int index = 0; index < attributes; ++index)
+            {
+                AddAttribute(document, xml);
+            }
+
+            document += ">";
+            AddText(document, 20 + Random(100));
+            document += string("</") + tag + ">";
+        }
+            break;
+        case 1:
+            document += Random(2) == 0 ? "<br/>" : (xml ? "<img src='images/a.png' alt=\"a picture\"/>" : "<img src='images/a.png' alt=\"a picture\" width=400 />");
+            break;
+        case 2:
+            document += "<!-- ";
+            AddText(document, Random(40));
+            document += " -->";
+            break;
+        case 3:
+            document += "<p>";
+            AddText(document, Random(60));
+            document += " <b>";
+            AddWord(document);
+            document += "</b> <a href=\"index.html\">";
+            AddWord(document);
+            document += "</a> ";
+            AddText(document, Random(60));
+            document += "</p>";
+            break;
+        default:
+        {
+            unsigned int kind = Random(4);
+            document += string("<") + containerTags[kind];
+            int attributes = Random(3);
+            for(int index = 0; index < attributes; ++index)
+            {
+                AddAttribute(document, xml);
+            }
+
+            document += ">\r\n";
+            int children = 1 + Random(4);
+            for(int index = 0; index < children; ++index)
+            {
+                if(string(childTags[kind][1]) == containerTags[kind])
+                {
+                    AddElement(document, xml, depth + 1);
+                }
+                else
+                {
+                    document += string("<") + childTags[kind][1] + ">";
+                    AddElement(document, xml, depth + 1);
+                    document += string("</") + childTags[kind][1] + ">";
+                }
+
+                document += "\r\n";
+            }
+
+            document += string("</") + containerTags[kind] + ">";
+        }
+            break;
+    }
+}
+
+void DocumentGenerator::AddNearMissElement(string &document, bool xml, int depth)
+{
+    switch(Random(depth < 6 ? 3 : 2))
+    {
+        case 0:
+        {
+            // A void element with a long start tag: it is read as the start of a normal element first, which fails at the "/"
+            document += "<img";
+            int attributes = 8 + Random(8);
+            for(int index = 0; index < attributes; ++index)
+            {
+                AddAttribute(document, xml);
+            }
+
+            document += " />";
+        }
+            break;
+        case 1:
+        {
+            // Attributes are tried as double quoted, single quoted, unquoted and then empty, so these go through the most alternatives
+            document += "<p";
+            int attributes = 4 + Random(8);
+            for(int index = 0; index < attributes; ++index)
+            {
+                string name = string(" data-") + Choose(words, Random(30)) + "-" + Choose(words, Random(30)) + "-" + Choose(words, Random(30));
+                if(xml)
+                {
+                    document += name + "='";
+                    AddWord(document);
+                    document += "'";
+                }
+                else
+                {
+                    document += name;
+                    if(Random(2) == 0)
+                    {
+                        document += "=";
+                        AddWord(document);
+                    }
+                }
+            }
+
+            document += ">";
+            AddText(document, Random(40));
+            document += "</p>";
+        }
+            break;
+        default:
+        {
+            const char *tag = Choose(styleNearMissTags, Random(3));
+            document += string("<") + tag + ">\r\n";
+            int children = 1 + Random(3);
+            for(int index = 0; index < children; ++index)
+            {
+                AddNearMissElement(document, xml, depth + 1);
+                document += "\r\n";
+            }
+
+            document += string("</") + tag + ">";
+        }
+            break;
+    }
+}
+
+// Words and punctuation but nothing that ends text in any of the grammars: no "<", quotes, "*" or "/"
+void DocumentGenerator::AddText(string &document, long long length)
+{
+    long long end = (long long) document.size() + length;
+    while((long long) document.size() < end)
+    {
+        AddWord(document);
+        unsigned int next = Random(16);
+        if(next == 0)
+        {
+            document += "\r\n";
+        }
+        else if(next == 1)
+        {
+            document += Choose(punctuation, Random(8));
+            document += " ";
+        }
+        else
+        {
+            document += " ";
+        }
+    }
+}
+
+void DocumentGenerator::AddWord(string &document)
+{
+    document += Choose(words, Random(30));
+}
+
+string DocumentGenerator::Css(DocumentShape shape, long long size)
+{
+    string document = "/* Generated */\r\n";
+    switch(shape)
+    {
+        case DocumentShape::Typical:
+        case DocumentShape::NearMiss:
+            while((long long) document.size() < size)
+            {
+                AddCssRule(document, shape == DocumentShape::NearMiss);
+                document += "\r\n";
+            }
+            break;
+        case DocumentShape::Deep:
+            while((long long) document.size() < size)
+            {
+                // About 8 characters per compound selector
+                long long compounds = max(1LL, min((long long) m_maxDepth, (size - (long long) document.size()) / 8));
+                AddCssSelector(document, (int) compounds);
+                document += " { color: #fff; }\r\n";
+            }
+            break;
+        case DocumentShape::Wide:
+            document += "body {";
+            while((long long) document.size() < size)
+            {
+                document += "\r\n    ";
+                AddCssDeclaration(document, false);
+            }
+
+            document += "\r\n}\r\n";
+            break;
+        case DocumentShape::Attributes:
+            AddCssSelector(document, 1);
+            while((long long) document.size() < size)
+            {
+                document += ",\r\n";
+                AddCssSelector(document, 1 + Random(2));
+            }
+
+            document += " { margin: 0; }\r\n";
+            break;
+        case DocumentShape::Text:
+            while((long long) document.size() < size)
+            {
+                long long length = min(65536LL, size - (long long) document.size());
+                document += "/* ";
+                AddText(document, length / 2);
+                document += " */\r\n.text { font-family: \"";
+                AddText(document, length / 2);
+                document += "\"; }\r\n";
+            }
+            break;
+    }
+
+    return document;
+}
+
+string DocumentGenerator::Generate(const string &language, DocumentShape shape, long long size)
+{
+    if(language == "css")
+    {
+        return Css(shape, size);
+    }
+    else
+    {
+        return Markup(shape, size, language == "xml");
+    }
+}
+
+string DocumentGenerator::Markup(DocumentShape shape, long long size, bool xml)
+{
+    string document;
+    string end;
+    if(xml)
+    {
+        document = "<catalog>\r\n";
+        end = "</catalog>\r\n";
+    }
+    else
+    {
+        document = "<!-- Generated -->\r\n<html>\r\n<head><title>Generated</title>\r\n<style>\r\n";
+        for(int index = 0; index < 4; ++index)
+        {
+            AddCssRule(document, false);
+            document += "\r\n";
+        }
+
+        document += "</style>\r\n</head>\r\n<body>\r\n";
+        end = "</body>\r\n</html>\r\n";
+    }
+
+    switch(shape)
+    {
+        case DocumentShape::Typical:
+            while((long long) document.size() < size)
+            {
+                AddElement(document, xml, 0);
+                document += "\r\n";
+            }
+            break;
+        case DocumentShape::Deep:
+            while((long long) document.size() < size)
+            {
+                // "<div>" and "</div>" per level
+                long long levels = max(1LL, min((long long) m_maxDepth, (size - (long long) document.size()) / 11));
+                for(long long level = 0; level < levels; ++level)
+                {
+                    document += "<div>";
+                }
+
+                AddWord(document);
+                for(long long level = 0; level < levels; ++level)
+                {
+                    document += "</div>";
+                }
+
+                document += "\r\n";
+            }
+            break;
+        case DocumentShape::Wide:
+            document += "<ul>\r\n";
+            while((long long) document.size() < size)
+            {
+                document += "<li>";
+                AddWord(document);
+                document += "</li>\r\n";
+            }
+
+            document += "</ul>\r\n";
+            break;
+        case DocumentShape::Attributes:
+            document += "<div";
+            while((long long) document.size() < size)
+            {
+                AddAttribute(document, xml);
+                if(Random(8) == 0)
+                {
+                    document += "\r\n";
+                }
+            }
+
+            document += ">";
+            AddWord(document);
+            document += "</div>\r\n";
+            break;
+        case DocumentShape::Text:
+            while((long long) document.size() < size)
+            {
+                document += "<p>";
+                AddText(document, min(1048576LL, size - (long long) document.size()));
+                document += "</p>\r\n";
+            }
+            break;
+        case DocumentShape::NearMiss:
+            while((long long) document.size() < size)
+            {
+                AddNearMissElement(document, xml, 0);
+                document += "\r\n";
+            }
+            break;
+    }
+
+    return document + end;
+}
+
+bool DocumentGenerator::ParseShape(const string &name, DocumentShape &shape)
+{
+    for(DocumentShape candidate : Shapes())
+    {
+        if(ShapeName(candidate) == name)
+        {
+            shape = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+long long DocumentGenerator::ParseSize(const string &size)
+{
+    long long value = atoll(size.c_str());
+    char unit = size.size() > 0 ? (char) toupper(size[size.size() - 1]) : ' ';
+    return unit == 'K' ? value * 1024 : unit == 'M' ? value * 1024 * 1024 : value;
+}
+
+unsigned int DocumentGenerator::Random(unsigned int count)
+{
+    // Knuth's MMIX linear congruential generator, the high bits are the random ones
+    m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int) (m_state >> 33) % count;
+}
+
+string DocumentGenerator::ShapeName(DocumentShape shape)
+{
+    switch(shape)
+    {
+        case DocumentShape::Typical: return "typical";
+        case DocumentShape::Deep: return "deep";
+        case DocumentShape::Wide: return "wide";
+        case DocumentShape::Attributes: return "attributes";
+        case DocumentShape::Text: return "text";
+        case DocumentShape::NearMiss: return "nearmiss";
+    }
+
+    return "";
+}
+
+vector<DocumentShape> DocumentGenerator::Shapes()
+{
+    return { DocumentShape::Typical, DocumentShape::Deep, DocumentShape::Wide, DocumentShape::Attributes, DocumentShape::Text, DocumentShape::NearMiss };
+}
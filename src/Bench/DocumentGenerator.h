@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "FXPlatform/Utilities.h"
+
+// The kinds of documents DocumentGenerator makes. Each one stresses a different part of the parsers
+enum class DocumentShape
+{
+    // A mix of everything the grammar allows, like a real document
+    Typical,
+    // Elements nested maxDepth deep (CSS: selectors maxDepth compounds long)
+    Deep,
+    // One element with a huge number of children (CSS: one rule with a huge number of declarations)
+    Wide,
+    // Elements with huge attribute lists (CSS: huge selector lists)
+    Attributes,
+    // Long runs of text (CSS: long strings and comments)
+    Text,
+    // Things that almost match the first alternatives of OrExpressions and so make the parser backtrack as much as possible
+    NearMiss
+};
+
+// Makes documents that the grammars accept: HtmlDocumentRule for "html", CssDocument for "css" and the subset of XML that
+// XmlCompiler understands for "xml". The same seed, shape and size always make the same document on every platform so
+// results can be compared across runs and machines. See GeneratorMain.cpp for the indparse_gen tool that uses it
+class DocumentGenerator
+{
+public:
+    // The parser recurses for each level of nesting so much deeper documents won't fit on most stacks
+    static const int DefaultMaxDepth = 1000;
+
+    DocumentGenerator(unsigned int seed) :
+        m_maxDepth(DefaultMaxDepth),
+        m_state(seed)
+    {
+    }
+
+    // Makes a document of about size bytes (it stops at the first point past size where it can end the document)
+    // language is "xml", "html" or "css"
+    std::string Generate(const std::string &language, DocumentShape shape, long long size);
+
+    static bool ParseShape(const std::string &name, DocumentShape &shape);
+    static std::string ShapeName(DocumentShape shape);
+    static std::vector<DocumentShape> Shapes();
+    // Sizes like 64K or 8M
+    static long long ParseSize(const std::string &size);
+
+    // How deep DocumentShape::Deep nests. Note that the parser recurses for each level so deep documents need a big stack
+    ValueProperty(private, int, maxDepth);
+
+private:
+    void AddAttribute(std::string &document, bool xml);
+    void AddCssDeclaration(std::string &document, bool nearMiss);
+    void AddCssRule(std::string &document, bool nearMiss);
+    void AddCssSelector(std::string &document, int compounds);
+    void AddElement(std::string &document, bool xml, int depth);
+    void AddNearMissElement(std::string &document, bool xml, int depth);
+    void AddText(std::string &document, long long length);
+    void AddWord(std::string &document);
+    std::string Css(DocumentShape shape, long long size);
+    std::string Markup(DocumentShape shape, long long size, bool xml);
+    // A number from 0 to count - 1. Not using <random> because its distributions are different on each platform
+    unsigned int Random(unsigned int count);
+
+    unsigned long long m_state;
+};
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include "DocumentGenerator.h"
+using namespace std;
+
+namespace
+{
+    int Usage()
+    {
+        fprintf(stderr,
+            "Makes documents the parsers accept for testing them at scale.\r\n\r\n"
+            "Command line arguments: \r\n"
+            "	indparse_gen --language xml|html|css [--shape shape] [--size 64K] [--seed number] [--depth levels] [--out file] \r\n"
+            "		shape is typical (the default), deep, wide, attributes, text or nearmiss \r\n"
+            "		depth is how far deep documents nest (default 1000, much deeper ones overflow the parser's stack) \r\n"
+            "		The document is written to stdout if there is no file \r\n"
+            );
+        return 2;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    string language;
+    DocumentShape shape = DocumentShape::Typical;
+    long long size = 64 * 1024;
+    unsigned int seed = 1;
+    int depth = DocumentGenerator::DefaultMaxDepth;
+    string outPath;
+    for(int index = 1; index < argc; ++index)
+    {
+        string argument = argv[index];
+        bool hasValue = index + 1 < argc;
+        if(argument == "--language" && hasValue) { language = argv[++index]; }
+        else if(argument == "--shape" && hasValue) { if(!DocumentGenerator::ParseShape(argv[++index], shape)) { return Usage(); } }
+        else if(argument == "--size" && hasValue) { size = DocumentGenerator::ParseSize(argv[++index]); }
+        else if(argument == "--seed" && hasValue) { seed = (unsigned int) strtoul(argv[++index], nullptr, 10); }
+        else if(argument == "--depth" && hasValue) { depth = max(1, atoi(argv[++index])); }
+        else if(argument == "--out" && hasValue) { outPath = argv[++index]; }
+        else { return Usage(); }
+    }
+
+    if(language != "xml" && language != "html" && language != "css")
+    {
+        return Usage();
+    }
+
+    DocumentGenerator generator(seed);
+    generator.maxDepth(depth);
+    string document = generator.Generate(language, shape, size);
+    if(outPath.size() == 0)
+    {
+        fwrite(document.data(), 1, document.size(), stdout);
+        return 0;
+    }
+
+    ofstream file(outPath, ios::binary);
+    file.write(document.data(), document.size());
+    if(!file.good())
+    {
+        fprintf(stderr, "can't write '%s'\r\n", outPath.c_str());
+        return 2;
+    }
+
+    return 0;
+}
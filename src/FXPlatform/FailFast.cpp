@@ -29,6 +29,8 @@ void failfastThis_uncaught_exception_handler(void *thisPtr, bool expression, con
         }
         else
         {
+            // If traces are being buffered, they show what led up to this
+            DumpTraceBuffer();
             terminateCalled = true;
             std::terminate();
         }
@@ -74,6 +76,7 @@ void uncaught_exception_handler (void)
          }
     }
     
+    DumpTraceBuffer();
     fflush(stderr);
     
     if(previousHandler)
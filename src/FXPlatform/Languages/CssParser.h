@@ -70,7 +70,7 @@ namespace Html
         AndExpression<Args
         <
             LiteralExpression<BeginCommentBlock>,
-            NotLiteralExpression<EndCommentBlock>,
+            NotLiteralExpression<EndCommentBlock, FlattenType::Token>,
             LiteralExpression<EndCommentBlock>
         >
         , FlattenType::Delete, SymbolID::andExpression, errExpectedCssBlockComment>
@@ -365,7 +365,7 @@ namespace Html
         <
             AndExpression<Args
             <
-                CssValueNumber,
+                Memoized<CssValueNumber>,
                 OrExpression<Args
                 <
                     LiteralExpression<PixelString>,
@@ -392,7 +392,7 @@ namespace Html
             CssValueRgba,
             CssValueUrl,
             CssLengthValueRule,
-            CssValueNumber,
+            Memoized<CssValueNumber>,
             CssValueString,
             CssSelectorIdentifierRule<>
         >, FlattenType::None, CssSymbolID::cssValue, errExpectedCssDeclarationValueRule>
@@ -416,7 +416,7 @@ namespace Html
                     <
                         AndExpression<Args
                         <
-                            CssDeclarationValueRule,
+                            Memoized<CssDeclarationValueRule>,
                             CssWhitespaceRule,
                             OptionalExpression
                             <
@@ -29,6 +29,8 @@ namespace Html
     extern char errExpectedStartTag[];
     extern char errExpectedProcessingInstruction[];
 
+    // The tagName, attributeName, attributeValue and text nodes are TokenSymbols (see FlattenType::Token): leaves with no children
+    // whose ToString() is the text. Use ToString() instead of walking their children
     class HtmlSymbolID
     {
     public:
@@ -53,7 +55,7 @@ namespace Html
     typedef OneOrMoreExpression
         <
             CharOrNumberSymbol, 
-            FlattenType::None, 
+            FlattenType::Token, 
             HtmlSymbolID::tagName, 
             errExpectedTagName
         > TagNameRule;
@@ -64,7 +66,7 @@ namespace Html
     typedef OneOrMoreExpression
         <
             CharacterSetExceptSymbol<AttributeNameIllegalCharacters, FlattenType::None>,
-            FlattenType::None,
+            FlattenType::Token,
             HtmlSymbolID::attributeName,
             errExpectedAttributeName
         > AttributeNameRule;
@@ -98,7 +100,7 @@ namespace Html
             OptionalWhitespaceSymbol<>,
             OneOrMoreExpression
             <
-                CharacterSetExceptSymbol<UnquotedAttributeIllegalCharacters>, FlattenType::None, HtmlSymbolID::attributeValue>
+                CharacterSetExceptSymbol<UnquotedAttributeIllegalCharacters>, FlattenType::Token, HtmlSymbolID::attributeValue>
             >,
             FlattenType::None, HtmlSymbolID::attribute
         > UnquotedAttributeValueAttributeRule;
@@ -126,7 +128,7 @@ namespace Html
             ZeroOrMoreExpression
             <
                 CharacterSetExceptSymbol<SingleQuotedAttributeIllegalCharacters>, 
-                FlattenType::None, 
+                FlattenType::Token, 
                 HtmlSymbolID::attributeValue
             >,
             CharacterSymbol<SingleQuoteString>
@@ -142,7 +144,7 @@ namespace Html
             ZeroOrMoreExpression
             <
                 CharacterSetExceptSymbol<DoubleQuotedAttributeIllegalCharacters>, 
-                FlattenType::None, 
+                FlattenType::Token, 
                 HtmlSymbolID::attributeValue
             >,
             CharacterSymbol<DoubleQuoteString>
@@ -158,13 +160,14 @@ namespace Html
     //    unquoted attribute-value syntax
     //    single-quoted attribute-value syntax
     //    double-quoted attribute-value syntax
-    typedef OrExpression<Args
+    // Memoized because start tags get parsed again as void start tags (and others) when the element fails
+    typedef Memoized<OrExpression<Args
         <
             DoubleQuotedAttributeValueAttributeRule,
             SingleQuotedAttributeValueAttributeRule,
             UnquotedAttributeValueAttributeRule,
             EmptyAttributeRule
-        >> AttributeRule;
+        >>> AttributeRule;
 
     // start tags consist of the following parts, in exactly the following order:
     //     A "<" character.
@@ -175,7 +178,7 @@ namespace Html
     //    A ">" character.
     // StartTag
     // "<" TagNameRule (Whitespace Attribute)* OptionalWhitespace ["/"] ">"
-    typedef AndExpression<Args
+    typedef Memoized<AndExpression<Args
         <
             CharacterSymbol<LessThanString>,
             TagNameRule,
@@ -190,13 +193,13 @@ namespace Html
             >,
             OptionalWhitespaceSymbol<>,
             CharacterSymbol<GreaterThanString>
-        >, FlattenType::None, HtmlSymbolID::startTag, errExpectedStartTag> StartTagRule;
+        >, FlattenType::None, HtmlSymbolID::startTag, errExpectedStartTag>> StartTagRule;
 
     template<char *tagName>
     class StartSpecificTagRule : public AndExpression<Args
         <
             CharacterSymbol<LessThanString>,
-            LiteralExpression<tagName, FlattenType::None, HtmlSymbolID::tagName>,
+            LiteralExpression<tagName, FlattenType::Token, HtmlSymbolID::tagName>,
             ZeroOrMoreExpression
             <
                 AndExpression<Args
@@ -273,7 +276,7 @@ namespace Html
         <
             CharacterSymbol<LessThanString>,
             CharacterSymbol<ForwardSlashString>,
-            LiteralExpression<tagName, FlattenType::None, HtmlSymbolID::tagName>,
+            LiteralExpression<tagName, FlattenType::Token, HtmlSymbolID::tagName>,
             OptionalWhitespaceSymbol<>,
             CharacterSymbol<GreaterThanString>
         >, FlattenType::None, HtmlSymbolID::endTag>
@@ -301,7 +304,7 @@ namespace Html
     typedef AndExpression<Args
         <
             LiteralExpression<StartHtmlCommentString>,
-            NotLiteralExpression<EndHtmlCommentString>,
+            NotLiteralExpression<EndHtmlCommentString, FlattenType::Token>,
             LiteralExpression<EndHtmlCommentString>
         >, FlattenType::Delete> CommentRule;
 
@@ -310,9 +313,12 @@ namespace Html
     //      text
     //      character references
     // NormalCharacterElement ::= StartTag (Element | (Anything But <)+)* EndTag
+    // Once the start tag is parsed nothing else can match here (a void start tag needs a "/" where it has ">" and the end tag
+    // of its parent needs one where it has the tag name), so it cuts there and its events are sent as it is parsed
     typedef AndExpression<Args
         <
             StartTagRule,
+            CutExpression,
             ZeroOrMoreExpression
             <
                 OrExpression<Args
@@ -321,7 +327,7 @@ namespace Html
                     OneOrMoreExpression
                     <
                         CharacterSetExceptSymbol<LessThanString>,
-                        FlattenType::None, HtmlSymbolID::text
+                        FlattenType::Token, HtmlSymbolID::text
                     >
                 >>
             >,
@@ -350,7 +356,7 @@ namespace Html
     typedef AndExpression<Args
         <
             StartSpecificTagRule<StyleTagNameString>,
-            NotLiteralExpression<EndStyleTagString, FlattenType::None, HtmlSymbolID::text>,
+            NotLiteralExpression<EndStyleTagString, FlattenType::Token, HtmlSymbolID::text>,
             EndSpecificTagRule<StyleTagNameString>
         >, FlattenType::None, HtmlSymbolID::nonReplaceableTextElement, errExpectedElement> NonReplaceableCharacterElementRule;
 
@@ -96,6 +96,12 @@ public:
         return errors().size() == 0;
     }
     
+    virtual bool ProcessFlatAst(shared_ptr<FlatAst> ast)
+    {
+        result(ParseNode(ast->root()));
+        return errors().size() == 0;
+    }
+    
     // Can return nullptr if there is an error
     shared_ptr<XmlNode> ParseNode(shared_ptr<Symbol> elementSymbol)
     {
@@ -161,6 +167,70 @@ public:
         }
     }
     
+    // Same as ParseNode() above for when flatAst() is set
+    shared_ptr<XmlNode> ParseNode(FlatAstCursor elementNode)
+    {
+        switch(elementNode.symbolID())
+        {
+            case HtmlSymbolID::voidElement:
+                return ParseStartTag(elementNode);
+                break;
+                
+            case HtmlSymbolID::element:
+            {
+                // Create the element
+                shared_ptr<XmlElement> element = ParseStartTag(elementNode);
+                
+                // recurse on children
+                FlatAstCursor elementChildNode = elementNode.firstChild().nextSibling();
+                while(elementChildNode.valid())
+                {
+                    if(elementChildNode.symbolID() == HtmlSymbolID::endTag)
+                    {
+                        break;
+                    }
+                    
+                    shared_ptr<XmlNode> elementChild = ParseNode(elementChildNode);
+                    if(elementChild != nullptr)
+                    {
+                        element->AppendChild(elementChild);
+                        elementChildNode = elementChildNode.nextSibling();
+                    }
+                    else
+                    {
+                        // Error parsing child
+                        return nullptr;
+                    }
+                }
+                
+                // Confirm end tag matches start
+                string startTagName = element->nodeName();
+                string endTagName = GetChild(elementChildNode, 0, HtmlSymbolID::tagName).ToString();
+                if(startTagName != endTagName)
+                {
+                    errors().push_back(CompileError(-1, -1, "Start tag '" + startTagName + "' does not match end tag '" + endTagName +"'"));
+                    return nullptr;
+                }
+                
+                // return it
+                return element;
+            }
+                break;
+                
+            case HtmlSymbolID::text:
+            {
+                shared_ptr<XmlNode> textNode = shared_ptr<XmlNode>(new XmlNode());
+                textNode->nodeName("#text");
+                textNode->nodeValue(elementNode.ToString());
+                return textNode;
+            }
+                
+            default:
+                errors().push_back(CompileError(-1, -1, "Unknown node '" + elementNode.ToString() + "'"));
+                return nullptr;
+        }
+    }
+    
     shared_ptr<XmlElement> ParseStartTag(shared_ptr<Symbol> elementSymbol)
     {
         int startTagSymbolIndex = 0;
@@ -187,6 +257,29 @@ public:
         return element;
     }
     
+    shared_ptr<XmlElement> ParseStartTag(FlatAstCursor elementNode)
+    {
+        FlatAstCursor startTagNode = GetChild(elementNode, 0, HtmlSymbolID::startTag);
+        FlatAstCursor startTagNameNode = GetChild(startTagNode, 0, HtmlSymbolID::tagName);
+        
+        shared_ptr<XmlElement> element = shared_ptr<XmlElement>(new XmlElement());
+        element->nodeName(startTagNameNode.ToString());
+        
+        // Add the attributes
+        FlatAstCursor attributesNode = startTagNameNode.nextSibling();
+        FlatAstCursor attributeNode = attributesNode.valid() && attributesNode.symbolID() == HtmlSymbolID::attributes ? attributesNode.firstChild() : FlatAstCursor();
+        while(attributeNode.valid() && attributeNode.symbolID() == HtmlSymbolID::attribute)
+        {
+            FlatAstCursor attributeValueNode = GetChild(attributeNode, 1, HtmlSymbolID::attributeValue);
+            element->SetAttribute(
+                                  GetChild(attributeNode, 0, HtmlSymbolID::attributeName).ToString(),
+                                  attributeValueNode.valid() ? attributeValueNode.ToString() : "");
+            attributeNode = attributeNode.nextSibling();
+        }
+        
+        return element;
+    }
+    
 protected:
     ValueProperty(private, shared_ptr<XmlNode>, result);
 };
@@ -0,0 +1,283 @@
+#pragma once
+#include "FXPlatform/Languages/XmlCompiler.h"
+
+/*
+	Builds the same XmlNodes as XmlCompiler, with the same errors, but from the parser's events (see ParseEventHandler) instead of from
+	the finished tree. The XmlNodes are built as the events arrive and it only keeps the chain of nodes it is inside of, not the Symbols.
+	The parser sends each element once its start tag is parsed (see CutExpression) so it only builds Symbols for the elements that are
+	still open, but the XmlNodes are the whole document just like XmlCompiler's.
+*/
+class XmlEventCompiler : public Compiler<HtmlDocumentRule>
+{
+public:
+    XmlEventCompiler() :
+        m_capturing(0),
+        m_done(false)
+    {
+        events(true);
+    }
+
+    virtual void Initialize()
+    {
+        Compiler<HtmlDocumentRule>::Initialize();
+        m_capturing = 0;
+        m_done = false;
+        m_open.clear();
+        m_text.clear();
+        result(nullptr);
+    }
+
+protected:
+    virtual void Enter(unsigned short symbolID, long /* start */)
+    {
+        if(m_done)
+        {
+            return;
+        }
+
+        OpenNode node(symbolID, OpenNode::Kind::Ignore);
+        OpenNode *parent = m_open.size() > 0 ? &m_open.back() : nullptr;
+        if(parent != nullptr)
+        {
+            node.element = parent->element;
+        }
+
+        if(parent == nullptr || parent->kind == OpenNode::Kind::Element)
+        {
+            if(parent != nullptr && symbolID == HtmlSymbolID::startTag)
+            {
+                node.kind = OpenNode::Kind::StartTag;
+            }
+            else if(parent != nullptr && symbolID == HtmlSymbolID::endTag)
+            {
+                node.kind = OpenNode::Kind::EndTag;
+            }
+            else if(parent != nullptr && parent->symbolID == HtmlSymbolID::voidElement)
+            {
+                // Only has a start tag
+            }
+            else if(symbolID == HtmlSymbolID::element || symbolID == HtmlSymbolID::voidElement)
+            {
+                node.kind = OpenNode::Kind::Element;
+                node.element = shared_ptr<XmlElement>(new XmlElement());
+                AddNode(parent, node.element);
+            }
+            else
+            {
+                node.kind = symbolID == HtmlSymbolID::text ? OpenNode::Kind::Text : OpenNode::Kind::Unknown;
+                Capture(node);
+            }
+        }
+        else
+        {
+            switch(parent->kind)
+            {
+                case OpenNode::Kind::StartTag:
+                    if(symbolID == HtmlSymbolID::tagName)
+                    {
+                        node.kind = OpenNode::Kind::TagName;
+                        Capture(node);
+                    }
+                    else if(symbolID == HtmlSymbolID::attributes)
+                    {
+                        node.kind = OpenNode::Kind::Attributes;
+                    }
+                    break;
+
+                case OpenNode::Kind::Attributes:
+                    if(symbolID == HtmlSymbolID::attribute)
+                    {
+                        node.kind = OpenNode::Kind::Attribute;
+                    }
+                    break;
+
+                case OpenNode::Kind::Attribute:
+                    if(symbolID == HtmlSymbolID::attributeName || symbolID == HtmlSymbolID::attributeValue)
+                    {
+                        node.kind = OpenNode::Kind::AttributePart;
+                        Capture(node);
+                    }
+                    break;
+
+                case OpenNode::Kind::EndTag:
+                    if(symbolID == HtmlSymbolID::tagName)
+                    {
+                        node.kind = OpenNode::Kind::EndTagName;
+                        Capture(node);
+                    }
+                    break;
+
+                default:
+                    // Part of something being captured or ignored
+                    break;
+            }
+        }
+
+        m_open.push_back(node);
+    }
+
+    virtual void Leave(unsigned short /* symbolID */, long /* start */, long /* length */)
+    {
+        if(m_done)
+        {
+            return;
+        }
+
+        OpenNode node = m_open.back();
+        m_open.pop_back();
+        OpenNode *parent = m_open.size() > 0 ? &m_open.back() : nullptr;
+        string text;
+        if(node.textStart != string::npos)
+        {
+            text = m_text.substr(node.textStart);
+            if(--m_capturing == 0)
+            {
+                m_text.clear();
+            }
+        }
+
+        switch(node.kind)
+        {
+            case OpenNode::Kind::TagName:
+                node.element->nodeName(text);
+                break;
+
+            case OpenNode::Kind::AttributePart:
+                if(node.symbolID == HtmlSymbolID::attributeName)
+                {
+                    parent->attributeName = text;
+                }
+                else
+                {
+                    parent->attributeValue = text;
+                }
+                break;
+
+            case OpenNode::Kind::Attribute:
+                node.element->SetAttribute(node.attributeName, node.attributeValue);
+                break;
+
+            case OpenNode::Kind::EndTagName:
+                if(node.element->nodeName() != text)
+                {
+                    Fail("Start tag '" + node.element->nodeName() + "' does not match end tag '" + text +"'");
+                    return;
+                }
+                break;
+
+            case OpenNode::Kind::Text:
+            {
+                shared_ptr<XmlNode> textNode = shared_ptr<XmlNode>(new XmlNode());
+                textNode->nodeName("#text");
+                textNode->nodeValue(text);
+                AddNode(parent, textNode);
+            }
+                break;
+
+            case OpenNode::Kind::Unknown:
+                Fail("Unknown node '" + text + "'");
+                return;
+
+            default:
+                break;
+        }
+
+        // XmlCompiler only uses the first node in the document
+        m_done = m_open.size() == 0;
+    }
+
+    virtual void Token(unsigned short symbolID, FlattenType /* flattenType */, long start, long length, const string &text)
+    {
+        Enter(symbolID, start);
+        if(m_capturing > 0)
+        {
+            m_text.append(text);
+        }
+
+        Leave(symbolID, start, length);
+    }
+
+    // Only called if events() is turned off, the tree is handled the same way
+    virtual bool ProcessAst(shared_ptr<CompileResultType> ast)
+    {
+        long position = 0;
+        for(shared_ptr<Symbol> &symbol : *ast)
+        {
+            Send(symbol.get(), position);
+        }
+
+        return errors().size() == 0;
+    }
+
+    ValueProperty(private, shared_ptr<XmlNode>, result);
+
+private:
+    // A node that has been entered and not left yet
+    class OpenNode
+    {
+    public:
+        enum class Kind
+        {
+            Attribute,
+            AttributePart,
+            Attributes,
+            Element,
+            EndTag,
+            EndTagName,
+            Ignore,
+            StartTag,
+            TagName,
+            Text,
+            Unknown
+        };
+
+        OpenNode(unsigned short symbolID, Kind kind) :
+            kind(kind),
+            symbolID(symbolID),
+            textStart(string::npos)
+        {
+        }
+
+        string attributeName;
+        string attributeValue;
+        // The element this node is in (or is)
+        shared_ptr<XmlElement> element;
+        Kind kind;
+        unsigned short symbolID;
+        // Where its text starts in m_text if it is capturing, npos if not
+        size_t textStart;
+    };
+
+    void AddNode(OpenNode *parent, shared_ptr<XmlNode> node)
+    {
+        if(parent == nullptr)
+        {
+            result(node);
+        }
+        else
+        {
+            parent->element->AppendChild(node);
+        }
+    }
+
+    // Records the text of the tokens in node until it is left
+    void Capture(OpenNode &node)
+    {
+        node.textStart = m_text.size();
+        ++m_capturing;
+    }
+
+    // Like XmlCompiler, stops at the first error and has no result
+    void Fail(const string &error)
+    {
+        errors().push_back(CompileError(-1, -1, error));
+        result(nullptr);
+        m_done = true;
+    }
+
+    // How many of m_open are capturing text. m_text is only kept while any are
+    int m_capturing;
+    bool m_done;
+    vector<OpenNode> m_open;
+    string m_text;
+};
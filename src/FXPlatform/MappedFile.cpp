@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+#if defined(_WIN32)
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+MappedFile::MappedFile() :
+    m_data(nullptr),
+    m_size(0)
+#if defined(_WIN32)
+    , m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(nullptr)
+#endif
+{
+}
+
+#if defined(_WIN32)
+MappedFile::~MappedFile()
+{
+    if(m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+
+    if(m_mappingHandle != nullptr)
+    {
+        CloseHandle(m_mappingHandle);
+    }
+
+    if(m_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_fileHandle);
+    }
+}
+
+shared_ptr<MappedFile> MappedFile::Map(const string &fullPath)
+{
+    shared_ptr<MappedFile> file = shared_ptr<MappedFile>(new MappedFile());
+
+    // FILE_FLAG_SEQUENTIAL_SCAN is the Windows equivalent of madvise(MADV_SEQUENTIAL)
+    file->m_fileHandle = CreateFileA(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file->m_fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file->m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        return nullptr;
+    }
+
+    file->m_mappingHandle = CreateFileMappingA(file->m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(file->m_mappingHandle == nullptr)
+    {
+        return nullptr;
+    }
+
+    file->m_data = (const char *) MapViewOfFile(file->m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if(file->m_data == nullptr)
+    {
+        return nullptr;
+    }
+
+    file->m_size = (size_t) fileSize.QuadPart;
+    return file;
+}
+#else
+MappedFile::~MappedFile()
+{
+    if(m_data != nullptr)
+    {
+        munmap((void *) m_data, m_size);
+    }
+}
+
+shared_ptr<MappedFile> MappedFile::Map(const string &fullPath)
+{
+    int fileDescriptor = open(fullPath.c_str(), O_RDONLY);
+    if(fileDescriptor == -1)
+    {
+        return nullptr;
+    }
+
+    struct stat fileInfo;
+    if(fstat(fileDescriptor, &fileInfo) == -1 || fileInfo.st_size == 0)
+    {
+        close(fileDescriptor);
+        return nullptr;
+    }
+
+    // The mapping keeps its own reference to the file so the descriptor isn't needed after this
+    void *data = mmap(nullptr, (size_t) fileInfo.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if(data == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    // Only a hint, so failure doesn't matter
+    madvise(data, (size_t) fileInfo.st_size, MADV_SEQUENTIAL);
+
+    shared_ptr<MappedFile> file = shared_ptr<MappedFile>(new MappedFile());
+    file->m_data = (const char *) data;
+    file->m_size = (size_t) fileInfo.st_size;
+    return file;
+}
+#endif
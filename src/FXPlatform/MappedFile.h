@@ -0,0 +1,30 @@
+#pragma once
+#include <memory>
+#include <string>
+
+// Maps a whole file read-only into memory so it can be read straight out of the page cache
+// without copying it into a buffer first. The OS is told the file will be read sequentially
+// so it can read ahead aggressively and drop pages behind the reader.
+//
+// The mapping stays valid for as long as the MappedFile is alive.
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    // Returns nullptr if the file can't be opened or mapped (including empty files, which can't be mapped)
+    static std::shared_ptr<MappedFile> Map(const std::string &fullPath);
+
+    const char *data() { return m_data; }
+    size_t size() { return m_size; }
+
+private:
+    MappedFile();
+
+    const char *m_data;
+    size_t m_size;
+#if defined(_WIN32)
+    void *m_fileHandle;
+    void *m_mappingHandle;
+#endif
+};
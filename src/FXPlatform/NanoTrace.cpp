@@ -4,18 +4,236 @@
 #include <iomanip>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
 
 DEFINE_ENUM(SystemTraceType, SYSTEM_TRACE_TYPE);
 
 NanoTrace NanoTrace::m_nanoTrace(3000);
 const char *NanoTrace::m_replaceTokens[] = { "{0}", "{1}", "{2}", "{3}", "{4}", "{5}", "{6}", "{7}", "{8}", "{9}" };
 
+namespace
+{
+    // Each thread only writes to its own buffer so it doesn't need a lock
+    class TraceBuffer
+    {
+    public:
+        TraceBuffer() :
+            systemStart(chrono::system_clock::now()),
+            steadyStart(chrono::steady_clock::now()),
+            written(0)
+        {
+        }
+
+        // Timestamps come from the steady clock so they are turned into a time using the clocks when the buffer was created
+        time_t SystemTime(uint64_t timestamp)
+        {
+            chrono::steady_clock::duration sinceStart = chrono::steady_clock::duration(timestamp) - steadyStart.time_since_epoch();
+            return chrono::system_clock::to_time_t(systemStart + chrono::duration_cast<chrono::system_clock::duration>(sinceStart));
+        }
+
+        vector<BufferedTraceRecord> records;
+        chrono::system_clock::time_point systemStart;
+        chrono::steady_clock::time_point steadyStart;
+        // Total traces added since the buffer was last emptied, the next one goes in records[written % records.size()]
+        uint64_t written;
+    };
+
+    thread_local TraceBuffer threadTraceBuffer;
+}
+
 NanoTrace::NanoTrace(int size) :
     m_allowedTraceType((unsigned long)SystemTraceType::All),
-    m_detailLevel(TraceDetail::Normal)
+    m_buffered(false),
+    m_bufferSize(size),
+    m_detailLevel(TraceDetail::Normal),
+    m_timing(false)
 {
 }
 
+void TimingStats::Add(double elapsed)
+{
+    if(count == 0 || elapsed < minimum)
+    {
+        minimum = elapsed;
+    }
+
+    if(count == 0 || elapsed > maximum)
+    {
+        maximum = elapsed;
+    }
+
+    ++count;
+    total += elapsed;
+    ++histogram[Bucket(elapsed)];
+}
+
+int TimingStats::Bucket(double elapsed)
+{
+    double microseconds = elapsed * 1000000;
+    int bucket = 0;
+    while(microseconds >= 1 && bucket < HistogramBuckets - 1)
+    {
+        microseconds /= 2;
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+void BufferedTraceRecord::GetData(vector<string> &values) const
+{
+    int position = 0;
+    for(int dataIndex = 0; dataIndex < dataCount; ++dataIndex)
+    {
+        DataType type = (DataType) data[position++];
+        switch(type)
+        {
+        case DataType::Char:
+            values.push_back(lexical_cast<string>(data[position]));
+            position += sizeof(char);
+            break;
+        case DataType::Double:
+        {
+            double value;
+            memcpy(&value, data + position, sizeof(value));
+            values.push_back(lexical_cast<string>(value));
+            position += sizeof(value);
+            break;
+        }
+        case DataType::Signed:
+        {
+            int64_t value;
+            memcpy(&value, data + position, sizeof(value));
+            values.push_back(lexical_cast<string>(value));
+            position += sizeof(value);
+            break;
+        }
+        case DataType::String:
+        {
+            int length = (unsigned char) data[position++];
+            values.push_back(string(data + position, length));
+            position += length;
+            break;
+        }
+        case DataType::Unsigned:
+        {
+            uint64_t value;
+            memcpy(&value, data + position, sizeof(value));
+            values.push_back(lexical_cast<string>(value));
+            position += sizeof(value);
+            break;
+        }
+        }
+    }
+}
+
+void NanoTrace::DumpBuffer()
+{
+    TraceBuffer &buffer = threadTraceBuffer;
+    uint64_t count = min(buffer.written, (uint64_t) buffer.records.size());
+    for(uint64_t index = buffer.written - count; index < buffer.written; ++index)
+    {
+        const BufferedTraceRecord &buffered = buffer.records[index % buffer.records.size()];
+        vector<string> data;
+        buffered.GetData(data);
+
+        TraceRecord record;
+        record.dataCount(min((int) data.size(), (int) record.data().size()));
+        for(int dataIndex = 0; dataIndex < record.dataCount(); ++dataIndex)
+        {
+            record.data()[dataIndex] = data[dataIndex];
+        }
+
+        record.elapsedTime(0);
+        record.isTiming(false);
+        record.traceKey(buffered.traceKey);
+        record.timestamp(buffer.SystemTime(buffered.timestamp));
+
+        stringstream stream;
+        FormatTrace(record, stream);
+        DebugLogMessage(buffered.traceType, buffered.levelOfDetail, stream.str().c_str());
+    }
+
+    buffer.written = 0;
+}
+
+void NanoTrace::LogTimings()
+{
+    DebugLogMessage((int) SystemTraceType::System, TraceDetail::Normal, TimingReport().c_str());
+}
+
+string NanoTrace::TimingReport()
+{
+    map<string, TimingStats> timings = Timings();
+    stringstream stream;
+    for(auto &item : timings)
+    {
+        const TimingStats &stats = item.second;
+        stream << std::fixed << std::setprecision(6) << "Timing " << item.first << ": count " << stats.count << ", total " << stats.total 
+            << "s, min " << stats.minimum << "s, max " << stats.maximum << "s, mean " << (stats.count == 0 ? 0 : stats.total / stats.count) << "s\r\n";
+        for(int bucket = 0; bucket < TimingStats::HistogramBuckets; ++bucket)
+        {
+            if(stats.histogram[bucket] > 0)
+            {
+                if(bucket == 0)
+                {
+                    stream << "    < 1us";
+                }
+                else
+                {
+                    stream << "    < " << (1ULL << bucket) << "us";
+                }
+
+                stream << ": " << stats.histogram[bucket] << "\r\n";
+            }
+        }
+    }
+
+    return stream.str();
+}
+
+double NanoTrace::FinishTiming(const char *name, double startTime, int traceType, TraceDetail levelOfDetail, bool trace, double traceAbove)
+{
+    double elapsed = Now() - startTime;
+    if(m_timing)
+    {
+        lock_guard<mutex> lock(m_timingsLock);
+        m_timings[name].Add(elapsed);
+    }
+
+    // Timing may have only started because timing() is on
+    if(trace && elapsed > traceAbove && (traceType & allowedTraceType()) && levelOfDetail <= detailLevel())
+    {
+        TraceRecord record;
+        record.dataCount(0);
+        record.elapsedTime(elapsed);
+        record.isTiming(true);
+        record.traceKey(name);
+        record.timestamp(time(nullptr));
+
+        stringstream stream;
+        FormatTrace(record, stream);
+        DebugLogMessage(traceType, levelOfDetail, stream.str().c_str());
+    }
+
+    return elapsed;
+}
+
+BufferedTraceRecord &NanoTrace::NextBufferedRecord(const char *traceKey, int traceType, TraceDetail levelOfDetail)
+{
+    TraceBuffer &buffer = threadTraceBuffer;
+    if(buffer.records.size() != (size_t) m_bufferSize)
+    {
+        buffer.records.resize(m_bufferSize);
+        buffer.written = 0;
+    }
+
+    // Overwrites the oldest trace once the buffer is full
+    BufferedTraceRecord &record = buffer.records[buffer.written++ % buffer.records.size()];
+    record.Begin(traceKey, traceType, levelOfDetail, (uint64_t) chrono::steady_clock::now().time_since_epoch().count());
+    return record;
+}
+
 void NanoTrace::FormatTrace(TraceRecord& record, ostream& stream)
 {
 	string substitutedString = record.traceKey();
@@ -63,6 +281,39 @@ void NanoTrace::FormatTrace(TraceRecord& record, ostream& stream)
 	stream << "\r\n";
 }
 
+double NanoTrace::Now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void NanoTrace::ClearTiming(const string &name)
+{
+    lock_guard<mutex> lock(m_timingsLock);
+    m_timings.erase(name);
+}
+
+void NanoTrace::ClearTimings()
+{
+    lock_guard<mutex> lock(m_timingsLock);
+    m_timings.clear();
+}
+
+double NanoTrace::BeginTiming(const char *name, int traceType, TraceDetail levelOfDetail, bool trace, const string &value)
+{
+    if(trace)
+    {
+        TraceImpl(string(name) + " started", -1, traceType, levelOfDetail, false, nullptr, value.empty() ? 0 : 1, value.c_str());
+    }
+
+    return Now();
+}
+
+map<string, TimingStats> NanoTrace::Timings()
+{
+    lock_guard<mutex> lock(m_timingsLock);
+    return m_timings;
+}
+
 // Normally this is all true, but removed that code to reduce complexity and just returns 0:
 // Returns the current time at the end of the routine, useful for tracking the start of an event
 // if startTime > -1, then timingResult is filled in with the difference between startTime and the time at the beginning of the routine
@@ -82,6 +333,7 @@ double NanoTrace::TraceImpl(const string &traceKey, const double startTime, int
 
     record.dataCount(dataCount);
     record.elapsedTime(0);
+    record.isTiming(false);
     record.traceKey(traceKey);
     FailFastAssert(sizeof(time_t) <= sizeof(record.timestamp()));
     record.timestamp(time(nullptr));
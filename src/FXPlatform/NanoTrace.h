@@ -1,12 +1,17 @@
 #pragma once
+#include <algorithm>
 #include <cfloat>
+#include <cstdint>
+#include <cstring>
 #include <map>
 #include <limits>
 #include <mutex>
+#include "FailFast.h"
 #include "ReflectionEnum.h"
 #include <sstream>
 #include "SystemTraceType.h"
 #include "Utilities.h"
+#include <type_traits>
 #include <vector>
 using namespace std;
 
@@ -44,6 +49,143 @@ private:
 	string m_traceKey;
 };
 
+// A trace that NanoTrace keeps in a ring buffer when it is buffering (see NanoTrace::buffered()). Only a pointer to the
+// traceKey is kept so it must be a string literal (which it is when the TraceString macros are used). The data is copied
+// in as it is, without being turned into strings, and is only formatted when the buffer is dumped
+class BufferedTraceRecord
+{
+public:
+    // Enough for the data a trace normally has, strings that don't fit are cut off and data that doesn't fit is left out
+    static const int MaxDataLength = 216;
+    enum class DataType : char
+    {
+        Char,
+        Double,
+        Signed,
+        String,
+        Unsigned
+    };
+
+    void Begin(const char *key, int type, TraceDetail detail, uint64_t time)
+    {
+        traceKey = key;
+        traceType = type;
+        levelOfDetail = detail;
+        timestamp = time;
+        dataCount = 0;
+        dataLength = 0;
+        full = false;
+    }
+
+    void Add(char value) { AddValue(DataType::Char, &value, sizeof(value)); }
+    void Add(const char *value) { if(value == nullptr) { AddString("", 0); } else { AddString(value, strlen(value)); } }
+    void Add(const std::string &value) { AddString(value.data(), value.size()); }
+
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type Add(T value)
+    {
+        int64_t data = (int64_t) value;
+        AddValue(DataType::Signed, &data, sizeof(data));
+    }
+
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type Add(T value)
+    {
+        uint64_t data = (uint64_t) value;
+        AddValue(DataType::Unsigned, &data, sizeof(data));
+    }
+
+    template<class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type Add(T value)
+    {
+        double data = (double) value;
+        AddValue(DataType::Double, &data, sizeof(data));
+    }
+
+    // Anything else has to be turned into a string now since there is no telling if it will still be around later
+    template<class T>
+    typename std::enable_if<!std::is_arithmetic<T>::value>::type Add(const T &value)
+    {
+        Add(lexical_cast<string>(value));
+    }
+
+    // Turns the data back into the same strings that lexical_cast<string>() would have made from the values
+    void GetData(vector<string> &data) const;
+
+    const char *traceKey;
+    int traceType;
+    TraceDetail levelOfDetail;
+    // Ticks of std::chrono::steady_clock
+    uint64_t timestamp;
+    int dataCount;
+
+private:
+    void AddString(const char *value, size_t length)
+    {
+        // Strings are the type, a one byte length and then the characters
+        int available = MaxDataLength - dataLength - 2;
+        if(full || available < 0)
+        {
+            full = true;
+            return;
+        }
+
+        length = std::min(length, (size_t) available);
+        data[dataLength++] = (char) DataType::String;
+        data[dataLength++] = (char) (unsigned char) length;
+        memcpy(data + dataLength, value, length);
+        dataLength += (int) length;
+        ++dataCount;
+    }
+
+    void AddValue(DataType type, const void *value, int length)
+    {
+        // Once something is left out so is everything after it, so that what is there still lines up with {0}, {1}, etc.
+        if(full || dataLength + 1 + length > MaxDataLength)
+        {
+            full = true;
+            return;
+        }
+
+        data[dataLength++] = (char) type;
+        memcpy(data + dataLength, value, length);
+        dataLength += length;
+        ++dataCount;
+    }
+
+    int dataLength;
+    bool full;
+    char data[MaxDataLength];
+};
+
+// What NanoTrace has recorded about everything timed with the same name using the StartTiming and EndTiming macros. 
+// Times are in seconds
+class TimingStats
+{
+public:
+    // histogram[0] counts the times under 1 microsecond, histogram[n] the times from 2^(n-1) up to 2^n microseconds
+    // (and the last one everything longer)
+    static const int HistogramBuckets = 32;
+
+    TimingStats() :
+        count(0),
+        total(0),
+        minimum(0),
+        maximum(0),
+        histogram(HistogramBuckets, 0)
+    {
+    }
+
+    void Add(double elapsed);
+    static int Bucket(double elapsed);
+
+    int64_t count;
+    double total;
+    double minimum;
+    double maximum;
+    vector<int64_t> histogram;
+};
+
 // Used to set what traces get emitted
 #define SetTraceFilter(traceType, levelOfDetail) \
     NanoTrace::Global().allowedTraceType((int) (traceType)); \
@@ -54,17 +196,36 @@ private:
 #define AddTraceType(traceType) NanoTrace::Global().allowedTraceType(NanoTrace::Global().allowedTraceType() | (int) traceType);
 #define SetTraceLevelOfDetail(levelOfDetail) NanoTrace::Global().detailLevel(levelOfDetail);
 #define SetTraceFilterOnly(traceType) NanoTrace::Global().allowedTraceType((int) (traceType));
-
-// Used for timing but stubbed out to reduce code complexity
-#define ResetTiming(name) 
-#define StartTiming(name, traceType, levelOfDetail) 
-#define StartTiming1(name, traceType, levelOfDetail, value1) 
-#define EndTiming(name, traceType, levelOfDetail) 
-#define EndTimingAssert(name, maxTime, traceType, levelOfDetail)
-#define StartTimingOnly(name, traceType, levelOfDetail) 
-#define EndTimingOnly(name, traceType, levelOfDetail) 
-#define EndTimingTraceIf(name, maxTime, traceType, levelOfDetail) 
-#define EndTimingOnlyAssert(name, maxTime, traceType, levelOfDetail)
+// Used to keep traces in a ring buffer instead of logging them, and to log what is in the buffer
+#define SetTraceBuffered(value) NanoTrace::Global().buffered(value);
+#define DumpTraceBuffer() NanoTrace::Global().DumpBuffer();
+
+// Used for timing. The time between the start and end (in seconds) is added to the TimingStats for name (see NanoTrace::Timings())
+// when timing is on (see SetTiming()), whatever the trace filter is. Unless it is an ...Only macro it is also traced if traces of
+// traceType and levelOfDetail are allowed (see SetTraceFilter()). When neither is on, like traces, it costs almost nothing.
+// The ...Assert macros fail fast if it took longer than maxTime seconds, EndTimingTraceIf only traces if it did
+#define SetTiming(value) NanoTrace::Global().timing(value);
+#define TimingEnabled(traceType, levelOfDetail) \
+    (NanoTrace::Global().timing() || (((int) traceType & NanoTrace::Global().allowedTraceType()) && (levelOfDetail <= NanoTrace::Global().detailLevel())))
+#define ResetTiming(name) NanoTrace::Global().ClearTiming(#name);
+#define StartTiming(name, traceType, levelOfDetail) \
+    double name##TimingStart = TimingEnabled(traceType, levelOfDetail) ? NanoTrace::Global().BeginTiming(#name, (int) (traceType), levelOfDetail, true) : -1;
+#define StartTiming1(name, traceType, levelOfDetail, value1) \
+    double name##TimingStart = TimingEnabled(traceType, levelOfDetail) ? NanoTrace::Global().BeginTiming(#name, (int) (traceType), levelOfDetail, true, lexical_cast<string>(value1)) : -1;
+#define EndTiming(name, traceType, levelOfDetail) \
+    do { if(name##TimingStart >= 0) { NanoTrace::Global().FinishTiming(#name, name##TimingStart, (int) (traceType), levelOfDetail, true); } } while(0)
+#define EndTimingAssert(name, maxTime, traceType, levelOfDetail) \
+    do { if(name##TimingStart >= 0) { StaticFailFastAssertDesc(NanoTrace::Global().FinishTiming(#name, name##TimingStart, (int) (traceType), levelOfDetail, true) <= (maxTime), #name " took longer than " #maxTime " seconds"); } } while(0)
+#define StartTimingOnly(name, traceType, levelOfDetail) \
+    double name##TimingStart = TimingEnabled(traceType, levelOfDetail) ? NanoTrace::Global().BeginTiming(#name, (int) (traceType), levelOfDetail, false) : -1;
+#define EndTimingOnly(name, traceType, levelOfDetail) \
+    do { if(name##TimingStart >= 0) { NanoTrace::Global().FinishTiming(#name, name##TimingStart, (int) (traceType), levelOfDetail, false); } } while(0)
+#define EndTimingTraceIf(name, maxTime, traceType, levelOfDetail) \
+    do { if(name##TimingStart >= 0) { NanoTrace::Global().FinishTiming(#name, name##TimingStart, (int) (traceType), levelOfDetail, true, maxTime); } } while(0)
+#define EndTimingOnlyAssert(name, maxTime, traceType, levelOfDetail) \
+    do { if(name##TimingStart >= 0) { StaticFailFastAssertDesc(NanoTrace::Global().FinishTiming(#name, name##TimingStart, (int) (traceType), levelOfDetail, false) <= (maxTime), #name " took longer than " #maxTime " seconds"); } } while(0)
+// Logs the TimingStats for everything timed so far
+#define DumpTimings() NanoTrace::Global().LogTimings();
 
 #define TraceString(string, traceType, traceDetail) \
     if(((int) traceType & NanoTrace::Global().allowedTraceType()) && (traceDetail <= NanoTrace::Global().detailLevel())) \
@@ -120,14 +281,58 @@ private:
 class NanoTrace
 {
 public:
+    // size is how many traces each thread keeps when buffering
     NanoTrace(int size);
     
     unsigned long allowedTraceType() { return m_allowedTraceType; }
     void allowedTraceType(unsigned long value) { m_allowedTraceType = value; }
+    // When buffered, traces aren't formatted and logged right away. Instead each thread keeps the last traces it did in a
+    // ring buffer of BufferedTraceRecords that is allocated once, which is fast enough to leave Diagnostic traces on. 
+    // DumpBuffer() formats and logs them. Only traces that use a string literal for the traceKey (i.e. the TraceString macros) are
+    // buffered, the rest are logged as usual
+    bool buffered() { return m_buffered; }
+    void buffered(bool value) { m_buffered = value; }
     TraceDetail detailLevel() { return m_detailLevel; }
     void detailLevel(TraceDetail value) { m_detailLevel = value; }
+    // Logs the traces in the calling thread's buffer, oldest first, the same way they would have been logged if the 
+    // trace wasn't buffered. Then empties the buffer
+    void DumpBuffer();
     static NanoTrace &Global() { return m_nanoTrace; };
 
+    // Timing, use the StartTiming and EndTiming macros instead of calling these. BeginTiming() returns the time
+    // to pass to FinishTiming() which returns how long it took. FinishTiming() only traces if it took longer than traceAbove seconds
+    double BeginTiming(const char *name, int traceType, TraceDetail levelOfDetail, bool trace, const string &value = string());
+    double FinishTiming(const char *name, double startTime, int traceType, TraceDetail levelOfDetail, bool trace, double traceAbove = -1);
+    // The stats for everything timed since it was last reset, by name
+    map<string, TimingStats> Timings();
+    void ClearTiming(const string &name);
+    void ClearTimings();
+    // Logs TimingReport()
+    void LogTimings();
+    // When timing is on the StartTiming and EndTiming macros always add to Timings(), otherwise only when their trace is allowed
+    bool timing() { return m_timing; }
+    void timing(bool value) { m_timing = value; }
+    // The stats for each name from Timings(), with a line for each histogram bucket that has anything in it
+    string TimingReport();
+
+    // The TraceString macros end up here because traceKey is a literal, the rest are only used if not buffering
+    template <class... Values>
+    double Trace(const char *traceKey, const int traceType, const TraceDetail levelOfDetail, const Values &... values)
+    {
+        if(!m_buffered)
+        {
+            return Trace(string(traceKey), traceType, levelOfDetail, values...);
+        }
+
+        if((traceType & allowedTraceType()) && (levelOfDetail <= detailLevel()))
+        {
+            BufferedTraceRecord &record = NextBufferedRecord(traceKey, traceType, levelOfDetail);
+            AddBufferedData(record, values...);
+        }
+
+        return 0;
+    }
+
 	double Trace(const string& traceKey, const int traceType, const TraceDetail levelOfDetail)
 	{
 		return TraceImpl(traceKey, -1, traceType, levelOfDetail);
@@ -219,14 +424,30 @@ public:
 	};
 
 private:
+    static void AddBufferedData(BufferedTraceRecord & /* record */) {}
+    template <class T, class... Rest>
+    static void AddBufferedData(BufferedTraceRecord &record, const T &value, const Rest &... rest)
+    {
+        record.Add(value);
+        AddBufferedData(record, rest...);
+    }
+
 	static void FormatTrace(TraceRecord& record, ostream& stream);
+    // Seconds on a steady clock
+    static double Now();
+    BufferedTraceRecord &NextBufferedRecord(const char *traceKey, int traceType, TraceDetail levelOfDetail);
     double TraceImpl(const string &traceKey, const double startTime, int traceType, const TraceDetail levelOfDetail, bool timingOnly = false, double *timingResult = nullptr,
                         int dataCount = 0,
                         const char *data1 = nullptr, const char *data2 = nullptr, const char *data3 = nullptr, const char *data4= nullptr, const char *data5 = nullptr,  
                         const char *data6 = nullptr, const char *data7 = nullptr, const char *data8 = nullptr, const char *data9 = nullptr, const char *data10 = nullptr);
 
     unsigned long m_allowedTraceType;
+    bool m_buffered;
+    int m_bufferSize;
     TraceDetail m_detailLevel;
+    bool m_timing;
+    mutex m_timingsLock;
+    map<string, TimingStats> m_timings;
 	static NanoTrace m_nanoTrace;
     static const char *m_replaceTokens[];
 };
@@ -0,0 +1,86 @@
+#include "CharClass.h"
+using namespace FXPlat;
+
+CharClass::CharClass()
+{
+    for(int index = 0; index < 4; ++index)
+    {
+        m_bits[index] = 0;
+    }
+}
+
+CharClass::CharClass(const char *characters) : CharClass()
+{
+    for(const char *character = characters; *character != '\0'; ++character)
+    {
+        Add(*character);
+    }
+}
+
+CharClass CharClass::Range(char first, char last)
+{
+    CharClass result;
+    for(int character = (unsigned char) first; character <= (unsigned char) last; ++character)
+    {
+        result.Add((char) character);
+    }
+
+    return result;
+}
+
+CharClass CharClass::operator|(const CharClass &other) const
+{
+    CharClass result;
+    for(int index = 0; index < 4; ++index)
+    {
+        result.m_bits[index] = m_bits[index] | other.m_bits[index];
+    }
+
+    return result;
+}
+
+CharClass CharClass::operator&(const CharClass &other) const
+{
+    CharClass result;
+    for(int index = 0; index < 4; ++index)
+    {
+        result.m_bits[index] = m_bits[index] & other.m_bits[index];
+    }
+
+    return result;
+}
+
+CharClass CharClass::operator-(const CharClass &other) const
+{
+    CharClass result;
+    for(int index = 0; index < 4; ++index)
+    {
+        result.m_bits[index] = m_bits[index] & ~other.m_bits[index];
+    }
+
+    return result;
+}
+
+CharClass CharClass::operator~() const
+{
+    CharClass result;
+    for(int index = 0; index < 4; ++index)
+    {
+        result.m_bits[index] = ~m_bits[index];
+    }
+
+    return result;
+}
+
+bool CharClass::operator==(const CharClass &other) const
+{
+    for(int index = 0; index < 4; ++index)
+    {
+        if(m_bits[index] != other.m_bits[index])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
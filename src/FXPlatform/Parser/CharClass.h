@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+namespace FXPlat
+{
+    // A set of characters (really bytes) stored as 256 bits so that checking for a character is just a lookup.
+    // Build them from strings and ranges and combine them with | (union), - (difference), & (intersection) and ~ (negation):
+    //      CharClass identifier = CharClass(Chars) | CharClass(Numbers) | CharClass(Underscore);
+    //      CharClass text = ~CharClass("<&");
+    // Grammars use them through the CharacterClassSymbol rule in Parser.h
+    class CharClass
+    {
+    public:
+        CharClass();
+        // The characters in the string (not including the null at the end)
+        explicit CharClass(const char *characters);
+
+        static CharClass Range(char first, char last);
+
+        void Add(char character) { m_bits[(unsigned char) character >> 6] |= ((uint64_t) 1) << ((unsigned char) character & 63); }
+        bool Contains(char character) const { return ((m_bits[(unsigned char) character >> 6] >> ((unsigned char) character & 63)) & 1) != 0; }
+        void Remove(char character) { m_bits[(unsigned char) character >> 6] &= ~(((uint64_t) 1) << ((unsigned char) character & 63)); }
+
+        CharClass operator|(const CharClass &other) const;
+        CharClass operator&(const CharClass &other) const;
+        CharClass operator-(const CharClass &other) const;
+        CharClass operator~() const;
+        bool operator==(const CharClass &other) const;
+        bool operator!=(const CharClass &other) const { return !(*this == other); }
+
+    private:
+        uint64_t m_bits[4];
+    };
+}
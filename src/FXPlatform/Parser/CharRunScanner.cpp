@@ -0,0 +1,164 @@
+#include "CharRunScanner.h"
+using namespace FXPlat;
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RUN_SCANNER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// AVX2 isn't part of the x86-64 baseline, so it is compiled just for the function that uses it and only called if the CPU has it
+#define RUN_SCANNER_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef RUN_SCANNER_SSE2
+namespace
+{
+    int LowestBit(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return (int) index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // Both return how many characters from begin they checked without finding a stop, the caller checks the rest
+    long ScanSse2(const char *begin, const char *end, const char *stops, int stopCount, bool stopsHigh)
+    {
+        __m128i stopVectors[CharRunScanner::MaxVectorStops];
+        for(int index = 0; index < stopCount; ++index)
+        {
+            stopVectors[index] = _mm_set1_epi8(stops[index]);
+        }
+
+        const char *current = begin;
+        while(end - current >= 16)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i *) current);
+            unsigned int mask = stopsHigh ? (unsigned int) _mm_movemask_epi8(block) : 0;
+            for(int index = 0; index < stopCount; ++index)
+            {
+                mask |= (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block, stopVectors[index]));
+            }
+
+            if(mask != 0)
+            {
+                return (long) (current - begin) + LowestBit(mask);
+            }
+
+            current += 16;
+        }
+
+        return (long) (current - begin);
+    }
+
+#ifdef RUN_SCANNER_AVX2
+    __attribute__((target("avx2")))
+    long ScanAvx2(const char *begin, const char *end, const char *stops, int stopCount, bool stopsHigh)
+    {
+        __m256i stopVectors[CharRunScanner::MaxVectorStops];
+        for(int index = 0; index < stopCount; ++index)
+        {
+            stopVectors[index] = _mm256_set1_epi8(stops[index]);
+        }
+
+        const char *current = begin;
+        while(end - current >= 32)
+        {
+            __m256i block = _mm256_loadu_si256((const __m256i *) current);
+            unsigned int mask = stopsHigh ? (unsigned int) _mm256_movemask_epi8(block) : 0;
+            for(int index = 0; index < stopCount; ++index)
+            {
+                mask |= (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, stopVectors[index]));
+            }
+
+            if(mask != 0)
+            {
+                return (long) (current - begin) + LowestBit(mask);
+            }
+
+            current += 32;
+        }
+
+        return (long) (current - begin);
+    }
+
+    bool HasAvx2()
+    {
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2") != 0;
+        return hasAvx2;
+    }
+#endif
+}
+#endif
+
+CharRunScanner::CharRunScanner(const CharClass &run) :
+    m_run(run),
+    m_vectorized(false),
+    m_stopCount(0),
+    m_stopsHigh(false)
+{
+#ifdef RUN_SCANNER_SSE2
+    // The characters >= 0x80 are checked together using their top bit, so they all have to be in the run or all end it
+    CharClass high = CharClass::Range('\x80', '\xff');
+    CharClass runHigh = run & high;
+    if(runHigh != high && runHigh != CharClass())
+    {
+        return;
+    }
+
+    m_stopsHigh = runHigh == CharClass();
+    for(int character = 0; character < 0x80; ++character)
+    {
+        if(!run.Contains((char) character))
+        {
+            if(m_stopCount == MaxVectorStops)
+            {
+                m_stopCount = 0;
+                m_stopsHigh = false;
+                return;
+            }
+
+            m_stops[m_stopCount++] = (char) character;
+        }
+    }
+
+    m_vectorized = true;
+#endif
+}
+
+long CharRunScanner::Scan(const char *begin, const char *end) const
+{
+    long scanned = 0;
+#ifdef RUN_SCANNER_SSE2
+    if(m_vectorized)
+    {
+#ifdef RUN_SCANNER_AVX2
+        if(HasAvx2())
+        {
+            scanned = ScanAvx2(begin, end, m_stops, m_stopCount, m_stopsHigh);
+        }
+#endif
+        scanned += ScanSse2(begin + scanned, end, m_stops, m_stopCount, m_stopsHigh);
+    }
+#endif
+
+    return scanned + ScanScalar(begin + scanned, end);
+}
+
+long CharRunScanner::ScanScalar(const char *begin, const char *end) const
+{
+    const char *current = begin;
+    while(current < end && m_run.Contains(*current))
+    {
+        ++current;
+    }
+
+    return (long) (current - begin);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "CharClass.h"
+
+namespace FXPlat
+{
+    // Finds how long a run of characters that are all in a CharClass is, i.e. where the next character that isn't
+    // in the class is.  Used by the rules that repeat a single character rule (e.g. ZeroOrMoreExpression<CharacterSetExceptSymbol<LessThanString>>)
+    // and by NotLiteralExpression so they can consume the whole run at once instead of a character at a time.
+    //
+    // If the characters that end a run are a few specific characters (and/or all the characters >= 0x80) the scan
+    // compares 16 (SSE2) or 32 (AVX2) characters at a time on x86-64. Otherwise, or on other platforms, it checks each
+    // character against the class, which is still much faster than parsing each character.
+    class CharRunScanner
+    {
+    public:
+        // The most characters that can end a run for the vectorized scan to be used
+        static const int MaxVectorStops = 4;
+
+        explicit CharRunScanner(const CharClass &run);
+
+        // Returns the number of characters from the start of [begin, end) that are in the run class
+        long Scan(const char *begin, const char *end) const;
+        bool vectorized() const { return m_vectorized; }
+
+    private:
+        long ScanScalar(const char *begin, const char *end) const;
+
+        CharClass m_run;
+        bool m_vectorized;
+        // When vectorized, a run ends at any of these (and at every character >= 0x80 if m_stopsHigh)
+        char m_stops[MaxVectorStops];
+        int m_stopCount;
+        bool m_stopsHigh;
+    };
+}
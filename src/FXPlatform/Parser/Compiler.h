@@ -1,5 +1,8 @@
 #pragma once
 #include <fstream>
+#include "FXPlatform/MappedFile.h"
+#include "FlatAst.h"
+#include "ParseEventHandler.h"
 #include "Parser.h"
 #include <string>
 
@@ -33,49 +36,90 @@ namespace FXPlat
     //  1. create a class that derives from Compiler<baserule> where baserule is a rule that parses an entire document
     //  2. add members to that class which contain whatever you are compiling into.  I.e. whatever the document is supposed to become
     //  3. override virtual bool ProcessAst(shared_ptr<CompileResultType> ast) and turn the symbols created by the rules into whatever they become
+    //     (or set flatAst(true) and override ProcessFlatAst() to get the same tree as a FlatAst, or set events(true) and override
+    //     the (protected) ParseEventHandler methods to get it as it is parsed)
     template<class parser>
-    class Compiler
+    class Compiler : protected ParseEventHandler
     {
     public:
         typedef vector<shared_ptr<Symbol>> CompileResultType;
+        // Files at least this big are memory mapped instead of read through a stream
+        static const long DefaultMappedFileThreshold = 1024 * 1024;
+
+        Compiler() :
+            m_events(false),
+            m_flatAst(false),
+            m_mappedFileThreshold(DefaultMappedFileThreshold),
+            m_memoize(false)
+        {
+        }
+
         virtual ~Compiler()
         {
         }
         
         bool CompileDocument(const string &fullPath)
         {
-            shared_ptr<ifstream> stream = shared_ptr<ifstream>(new ifstream());
-            StartTimingOnly(Compiler_CompileDocument_LoadFile, SystemTraceType::HTML, TraceDetail::Detailed);
-            stream->open(fullPath, ios::binary);
-            EndTimingOnly(Compiler_CompileDocument_LoadFile, SystemTraceType::HTML, TraceDetail::Detailed);
-            if(stream->good())
-            {
-                return Compile(stream);
-            }
-            else
-            {
-                this->errors().push_back(CompileError(-1, -1, "error loading file '" + fullPath + "'"));
-                return false;
-            }
+            shared_ptr<Lexer> lexer = OpenDocument(fullPath);
+            return lexer != nullptr && Compile(lexer);
         }
 
+        // Parses directly out of a copy of the string which is much faster than going through a stream
         bool Compile(const string document)
         {
-            shared_ptr<istream> stream = shared_ptr<istream>(new stringstream(document));
-            stream->setf(ios::binary);
-            return Compile(stream);
+            shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
+            lexer->Open(shared_ptr<string>(new string(document)));
+            return Compile(lexer);
         }
 
         bool Compile(shared_ptr<istream> stream)
+        {
+            shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
+            lexer->Open(stream);
+            return Compile(lexer);
+        }
+
+        // Only checks that the document parses: the rules don't build any Symbols (see Lexer::validate()) and ProcessAst() isn't
+        // called, so it is much faster and uses almost no memory. Fails with the same errors() Compile() would have
+        bool ValidateDocument(const string &fullPath)
+        {
+            shared_ptr<Lexer> lexer = OpenDocument(fullPath);
+            return lexer != nullptr && Validate(lexer);
+        }
+
+        bool Validate(const string document)
+        {
+            shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
+            lexer->Open(shared_ptr<string>(new string(document)));
+            return Validate(lexer);
+        }
+
+        bool Validate(shared_ptr<istream> stream)
+        {
+            shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
+            lexer->Open(stream);
+            return Validate(lexer);
+        }
+
+        // lexer must already be Open()
+        bool Validate(shared_ptr<Lexer> lexer)
+        {
+            lexer->validate(true);
+            return Compile(lexer);
+        }
+
+        // lexer must already be Open()
+        bool Compile(shared_ptr<Lexer> lexer)
         {
             Initialize();
             shared_ptr<CompileResultType> result = shared_ptr<CompileResultType>(new CompileResultType());
-            shared_ptr<CompileError> error = this->Compile(stream, result);
+            shared_ptr<CompileError> error = this->Compile(lexer, result);
 
             //string foo = ParserDebug::PrintTree(*result);
 
             if(error != nullptr)
             {
+                m_flatAstBuilder = nullptr;
                 errors().push_back(*error);
                 TraceString1("Compiler::Compile Error {0}",
                              SystemTraceType::System, TraceDetail::Normal,
@@ -83,6 +127,33 @@ namespace FXPlat
                 return false;
             }
 
+            if(lexer->validate())
+            {
+                return true;
+            }
+
+            if(m_events || m_flatAst)
+            {
+                // The rules already sent whatever nothing could backtrack over, the rest is still here
+                ParseEventHandler *eventHandler = m_events ? static_cast<ParseEventHandler *>(this) : m_flatAstBuilder.get();
+                long position = 0;
+                for(shared_ptr<Symbol> &symbol : *result)
+                {
+                    eventHandler->Send(symbol.get(), position);
+                }
+
+                if(m_events)
+                {
+                    return !HasErrors();
+                }
+
+                // The Symbols aren't needed anymore
+                result = nullptr;
+                shared_ptr<FlatAst> flatAst = m_flatAstBuilder->Finish();
+                m_flatAstBuilder = nullptr;
+                return ProcessFlatAst(flatAst);
+            }
+
             return ProcessAst(result);
         }
 
@@ -114,6 +185,32 @@ namespace FXPlat
             return GetChild(level0Symbol, level1Index, ID1, level2Index, ID2);
         }
 
+        // Same as above for a FlatAst, returns a cursor that isn't valid() instead of nullptr
+        static FlatAstCursor GetChild(FlatAstCursor node, int level0Index, int ID0)
+        {
+            FlatAstCursor found = node.valid() ? node.child(level0Index) : FlatAstCursor();
+            if(found.valid() && (ID0 == -1 || found.symbolID() == ID0))
+            {
+                return found;
+            }
+
+            return FlatAstCursor();
+        }
+
+        static FlatAstCursor GetChild(FlatAstCursor node, int level0Index, int ID0, int level1Index, int ID1)
+        {
+            FlatAstCursor level0Node = GetChild(node, level0Index, ID0);
+            if(!level0Node.valid()) { return level0Node; }
+            return GetChild(level0Node, level1Index, ID1);
+        }
+
+        static FlatAstCursor GetChild(FlatAstCursor rootNode, int level0Index, int ID0, int level1Index, int ID1, int level2Index, int ID2)
+        {
+            FlatAstCursor level0Node = GetChild(rootNode, level0Index, ID0);
+            if(!level0Node.valid()) { return level0Node; }
+            return GetChild(level0Node, level1Index, ID1, level2Index, ID2);
+        }
+
         string GetErrorString()
         {
             stringstream stream;
@@ -133,25 +230,115 @@ namespace FXPlat
         }
 
         Property(private, vector<CompileError>, errors);
+        // Sends the tree to the ParseEventHandler methods as it is parsed instead of handing it to ProcessAst(), see ParseEventHandler.
+        // Compile() fails if they add any errors()
+        ValueProperty(private, bool, events);
+        // Hands the tree to ProcessFlatAst() as a FlatAst instead of to ProcessAst() as Symbols. It is built from the events as
+        // the document is parsed (see FlatAstBuilder) so the Symbols that are sent as they are parsed are released right away.
+        // Walking it is faster too. Ignored if events() is set
+        ValueProperty(private, bool, flatAst);
+        // Set to -1 to never memory map files
+        ValueProperty(private, long, mappedFileThreshold);
+        // Turns on Packrat memoization (see Lexer::memoize()) for each compile. Grammars that backtrack a lot parse faster
+        // but it uses memory for every rule tried at every position, the tree is the same either way
+        ValueProperty(private, bool, memoize);
+        // Set to record how much work each rule does during each compile, see RuleProfiler
+        ValueProperty(private, shared_ptr<RuleProfiler>, profiler);
+        // Set to allocate the Symbols for each compile from an arena instead of the heap, see SymbolArena. Each Compile() starts the
+        // arena over, so anything still holding Symbols from the last one (whatever ProcessAst() kept, the Lexer it was given)
+        // has to release them first or Compile() fails. The arena must also outlive them: members of a derived class are destroyed
+        // before this one is so they can hold Symbols, but anything that outlives the Compiler needs its own reference to the arena
+        ValueProperty(private, shared_ptr<SymbolArena>, arena);
 
     protected:
+        // Returns nullptr and adds an error if the file can't be opened
+        shared_ptr<Lexer> OpenDocument(const string &fullPath)
+        {
+            shared_ptr<ifstream> stream = shared_ptr<ifstream>(new ifstream());
+            StartTimingOnly(Compiler_CompileDocument_LoadFile, SystemTraceType::HTML, TraceDetail::Detailed);
+            stream->open(fullPath, ios::binary);
+            EndTimingOnly(Compiler_CompileDocument_LoadFile, SystemTraceType::HTML, TraceDetail::Detailed);
+            if(!stream->good())
+            {
+                this->errors().push_back(CompileError(-1, -1, "error loading file '" + fullPath + "'"));
+                return nullptr;
+            }
+
+            // Big files are parsed straight out of the page cache, falling back to the stream if they can't be mapped
+            shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
+            stream->seekg(0, ios::end);
+            long long fileSize = (long long) stream->tellg();
+            stream->seekg(0);
+            if(m_mappedFileThreshold >= 0 && fileSize >= m_mappedFileThreshold && fileSize <= (long long) numeric_limits<long>::max())
+            {
+                shared_ptr<MappedFile> mappedFile = MappedFile::Map(fullPath);
+                if(mappedFile != nullptr)
+                {
+                    stream->close();
+                    lexer->Open(mappedFile->data(), (long) mappedFile->size(), mappedFile);
+                    return lexer;
+                }
+            }
+
+            lexer->Open(stream);
+            return lexer;
+        }
+
         shared_ptr<CompileError> Compile(shared_ptr<istream> stream, shared_ptr<CompileResultType> &flattened)
         {
             shared_ptr<Lexer> lexer = shared_ptr<Lexer>(new Lexer());
             lexer->Open(stream);
+            return Compile(lexer, flattened);
+        }
+
+        shared_ptr<CompileError> Compile(shared_ptr<Lexer> lexer, shared_ptr<CompileResultType> &flattened)
+        {
+            if(m_memoize)
+            {
+                lexer->memoize(true);
+            }
+
+            if(m_profiler != nullptr)
+            {
+                lexer->profiler(m_profiler);
+            }
+
+            if(m_arena != nullptr)
+            {
+                // Otherwise the arena would keep growing for as long as they are held
+                if(!m_arena->Reset())
+                {
+                    return shared_ptr<CompileError>(new CompileError(-1, -1, "Symbols from the last compile are still alive, they have to be released before the arena can be used again"));
+                }
+
+                lexer->arena(m_arena);
+            }
+
+            if(m_events)
+            {
+                lexer->eventHandler(this);
+            }
+            else if(m_flatAst && !lexer->validate())
+            {
+                m_flatAstBuilder = shared_ptr<FlatAstBuilder>(new FlatAstBuilder());
+                lexer->eventHandler(m_flatAstBuilder.get());
+            }
 
             StartTimingOnly(Compiler_Compile_Parse, SystemTraceType::HTML, TraceDetail::Detailed);
             shared_ptr<Symbol> result = parser::TryParse(lexer, "");
             EndTimingOnly(Compiler_Compile_Parse, SystemTraceType::HTML, TraceDetail::Detailed);
 
-            if(result != nullptr)
+            if(m_events || m_flatAstBuilder != nullptr)
             {
-                // No Errors, flatten now
+                // The lexer can outlive this
+                lexer->eventHandler(nullptr);
+            }
 
+            if(result != nullptr)
+            {
+                // No Errors. Everything below the root was flattened as it was parsed (see Symbol::AddSubsymbol()), only the root is left
                 flattened = shared_ptr<vector<shared_ptr<Symbol>>>(new vector<shared_ptr<Symbol>>());
-                StartTimingOnly(Compiler_Compile_Flatten, SystemTraceType::HTML, TraceDetail::Detailed);
                 result->FlattenInto(*flattened);
-                EndTimingOnly(Compiler_Compile_Flatten, SystemTraceType::HTML, TraceDetail::Detailed);
                 return nullptr;
             }
             else
@@ -160,12 +347,23 @@ namespace FXPlat
                 int lineCount;
                 int columnCount;
                 string errorLine;
-                Lexer::GetLineAndColumn(lexer->DeepestFailure(), stream, lineCount, columnCount, &errorLine);
+                lexer->GetLineAndColumn(lexer->DeepestFailure(), lineCount, columnCount, &errorLine);
                 return shared_ptr<CompileError>(new CompileError(lineCount, columnCount, lexer->ErrorMessage() + ", \r\n" + errorLine));
             }
         }
 
 		// This must be overridden to actually process the tree that got parsed
         virtual bool ProcessAst(shared_ptr<CompileResultType> ast) = 0;
+
+		// This must be overridden too if flatAst() is set
+        virtual bool ProcessFlatAst(shared_ptr<FlatAst> /* ast */)
+        {
+            FailFastAssertDesc(false, "flatAst() is set but ProcessFlatAst() isn't overridden");
+            return false;
+        }
+
+    private:
+        // Builds the FlatAst during Compile() if flatAst() is set
+        shared_ptr<FlatAstBuilder> m_flatAstBuilder;
     };
 }
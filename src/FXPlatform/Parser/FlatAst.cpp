@@ -0,0 +1,81 @@
+#include "FlatAst.h"
+using namespace FXPlat;
+using namespace std;
+
+shared_ptr<FlatAst> FlatAst::Build(const vector<shared_ptr<Symbol>> &symbols)
+{
+    FlatAstBuilder builder;
+    long position = 0;
+    for(const shared_ptr<Symbol> &root : symbols)
+    {
+        builder.Send(root.get(), position);
+    }
+
+    return builder.Finish();
+}
+
+FlatAstBuilder::FlatAstBuilder() :
+    m_ast(shared_ptr<FlatAst>(new FlatAst())),
+    m_lastChildren(1, -1)
+{
+}
+
+int FlatAstBuilder::Add(unsigned short symbolID, FlattenType flattenType, long start, long length)
+{
+    int index = (int) m_ast->m_symbolIDs.size();
+    m_ast->m_symbolIDs.push_back(symbolID);
+    m_ast->m_flattenTypes.push_back(flattenType);
+    m_ast->m_childCounts.push_back(0);
+    m_ast->m_nextSiblings.push_back(-1);
+    m_ast->m_starts.push_back(start);
+    m_ast->m_lengths.push_back(length);
+    m_ast->m_textStarts.push_back((long) m_ast->m_text.size());
+    m_ast->m_textLengths.push_back(0);
+
+    int &previous = m_lastChildren.back();
+    if(previous != -1)
+    {
+        m_ast->m_nextSiblings[previous] = index;
+    }
+
+    previous = index;
+    if(m_open.size() > 0)
+    {
+        ++m_ast->m_childCounts[m_open.back()];
+    }
+
+    return index;
+}
+
+void FlatAstBuilder::Enter(unsigned short symbolID, long start)
+{
+    // Only leaves can be Tokens
+    m_open.push_back(Add(symbolID, FlattenType::None, start, 0));
+    m_lastChildren.push_back(-1);
+}
+
+void FlatAstBuilder::Leave(unsigned short /* symbolID */, long /* start */, long length)
+{
+    // The text of a node is what its leaves have
+    int index = m_open.back();
+    m_ast->m_lengths[index] = length;
+    m_ast->m_textLengths[index] = (long) m_ast->m_text.size() - m_ast->m_textStarts[index];
+    m_open.pop_back();
+    m_lastChildren.pop_back();
+}
+
+void FlatAstBuilder::Token(unsigned short symbolID, FlattenType flattenType, long start, long length, const string &text)
+{
+    int index = Add(symbolID, flattenType, start, length);
+    m_ast->m_text.append(text);
+    m_ast->m_textLengths[index] = (long) text.size();
+}
+
+shared_ptr<FlatAst> FlatAstBuilder::Finish()
+{
+    shared_ptr<FlatAst> ast = m_ast;
+    m_ast = shared_ptr<FlatAst>(new FlatAst());
+    m_lastChildren.assign(1, -1);
+    m_open.clear();
+    return ast;
+}
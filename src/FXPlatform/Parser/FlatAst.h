@@ -0,0 +1,142 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "ParseEventHandler.h"
+#include "Parser.h"
+
+namespace FXPlat
+{
+    class FlatAst;
+
+	// Points at one node of a FlatAst. Cheap to copy, walk the tree with firstChild() and nextSibling():
+	//
+	//      for(FlatAstCursor child = node.firstChild(); child.valid(); child = child.nextSibling()) { ... }
+	//
+	// A cursor that went off the end of the tree (or was never set) is not valid() and must not be asked for anything else
+    class FlatAstCursor
+    {
+    public:
+        FlatAstCursor() :
+            m_ast(nullptr),
+            m_index(-1)
+        {
+        }
+
+        FlatAstCursor(const FlatAst *ast, int index) :
+            m_ast(ast),
+            m_index(index)
+        {
+        }
+
+        bool valid() const { return m_index != -1; }
+        int index() const { return m_index; }
+
+        inline unsigned short symbolID() const;
+        inline FlattenType flattenType() const;
+        inline long start() const;
+        inline long length() const;
+        inline int childCount() const;
+        // Same as Symbol::ToString() for the Symbol this node came from
+        inline string ToString() const;
+
+        inline FlatAstCursor firstChild() const;
+        inline FlatAstCursor nextSibling() const;
+        // Walks the siblings so it is linear in index
+        FlatAstCursor child(int index) const
+        {
+            FlatAstCursor found = firstChild();
+            while(found.valid() && index-- > 0)
+            {
+                found = found.nextSibling();
+            }
+
+            return found;
+        }
+
+        bool operator==(const FlatAstCursor &other) const { return m_ast == other.m_ast && m_index == other.m_index; }
+        bool operator!=(const FlatAstCursor &other) const { return !(*this == other); }
+
+    private:
+        const FlatAst *m_ast;
+        int m_index;
+    };
+
+	// A flattened parse tree (see Symbol::FlattenInto()) stored as one array per field instead of a Symbol object per node: the
+	// nodes are in document order (each node comes right before its children) so walking the tree reads each array from front to
+	// back instead of chasing pointers around the heap. The text of every leaf is copied into one string, in order, so the text of
+	// any node is one contiguous piece of it.
+	//
+	// Set Compiler::flatAst() to get one instead of the Symbols, it is built from the parser's events as the document is parsed (see
+	// FlatAstBuilder). Build() makes one from a flattened tree that was already parsed, which needs the memory for both. Nothing points
+	// back into the Symbols or the document so it can outlive both
+    class FlatAst
+    {
+        friend class FlatAstBuilder;
+
+    public:
+        // symbols must already be flattened, they are the roots
+        static shared_ptr<FlatAst> Build(const vector<shared_ptr<Symbol>> &symbols);
+
+        FlatAstCursor root() const { return FlatAstCursor(this, m_symbolIDs.size() > 0 ? 0 : -1); }
+        int size() const { return (int) m_symbolIDs.size(); }
+        const string &text() const { return m_text; }
+
+        // The arrays, all indexed by node, for code that wants to loop over every node without a cursor
+        const vector<int> &childCounts() const { return m_childCounts; }
+        const vector<FlattenType> &flattenTypes() const { return m_flattenTypes; }
+        const vector<long> &lengths() const { return m_lengths; }
+        // The index of the node after this one's last descendant that has the same parent, or -1
+        const vector<int> &nextSiblings() const { return m_nextSiblings; }
+        // Where each node is in the document. Characters the Lexer hands out don't know where they are (see Symbol::start()) and
+        // get the position right after the node before them instead
+        const vector<long> &starts() const { return m_starts; }
+        const vector<unsigned short> &symbolIDs() const { return m_symbolIDs; }
+        const vector<long> &textLengths() const { return m_textLengths; }
+        const vector<long> &textStarts() const { return m_textStarts; }
+
+    private:
+        vector<int> m_childCounts;
+        vector<FlattenType> m_flattenTypes;
+        vector<long> m_lengths;
+        vector<int> m_nextSiblings;
+        vector<long> m_starts;
+        vector<unsigned short> m_symbolIDs;
+        string m_text;
+        vector<long> m_textLengths;
+        vector<long> m_textStarts;
+    };
+
+	// Builds a FlatAst out of the events for a tree (see ParseEventHandler). Set it as the Lexer::eventHandler() to build the FlatAst
+	// while the document is parsed: the parts of the tree that are sent as they are parsed never stay around as Symbols
+    class FlatAstBuilder : public ParseEventHandler
+    {
+    public:
+        FlatAstBuilder();
+
+        virtual void Enter(unsigned short symbolID, long start);
+        virtual void Leave(unsigned short symbolID, long start, long length);
+        virtual void Token(unsigned short symbolID, FlattenType flattenType, long start, long length, const std::string &text);
+
+        // Returns the FlatAst for the events so far and starts a new one
+        shared_ptr<FlatAst> Finish();
+
+    private:
+        int Add(unsigned short symbolID, FlattenType flattenType, long start, long length);
+
+        shared_ptr<FlatAst> m_ast;
+        // The last child added to each node in m_open (or -1 if none has been), the one before them is the last root
+        vector<int> m_lastChildren;
+        // The nodes that have been entered and not left yet
+        vector<int> m_open;
+    };
+
+    unsigned short FlatAstCursor::symbolID() const { return m_ast->symbolIDs()[m_index]; }
+    FlattenType FlatAstCursor::flattenType() const { return m_ast->flattenTypes()[m_index]; }
+    long FlatAstCursor::start() const { return m_ast->starts()[m_index]; }
+    long FlatAstCursor::length() const { return m_ast->lengths()[m_index]; }
+    int FlatAstCursor::childCount() const { return m_ast->childCounts()[m_index]; }
+    string FlatAstCursor::ToString() const { return m_ast->text().substr((size_t) m_ast->textStarts()[m_index], (size_t) m_ast->textLengths()[m_index]); }
+    FlatAstCursor FlatAstCursor::firstChild() const { return FlatAstCursor(m_ast, childCount() > 0 ? m_index + 1 : -1); }
+    FlatAstCursor FlatAstCursor::nextSibling() const { return FlatAstCursor(m_ast, m_ast->nextSiblings()[m_index]); }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace FXPlat
+{
+    // Allow you to control "flattening" which controls what the tree looks like if the node is successful:
+    //  - Flatten means take this symbol out of the tree and reparent its children to its parent (which is useful for nodes that are there for mechanics, not the meaning of the parse tree)
+    //  - Delete means remove this symbol and all children completely (which you might want to do for a comment)
+    //  - None means leave this node in the tree (for when the node is meaningful like a name of something)
+    //  - Token means leave this node in the tree as a TokenSymbol: a leaf that just records the text that was matched instead of having a
+    //    child Symbol for every character. Much smaller and faster for things like names and text. Only the rules that match text support it: 
+    //    AtLeastAndAtMostExpression (and the wrappers like OneOrMoreExpression), LiteralExpression and NotLiteralExpression. Others treat it like None
+    enum class FlattenType
+    {
+        None,
+        Delete,
+        Flatten,
+        Token
+    };
+}
@@ -1,10 +1,19 @@
 #include "Lexer.h"
+#include "CharRunScanner.h"
 #include "Parser.h"
+#include "RuleProfiler.h"
+#include <algorithm>
 using namespace FXPlat;
 using namespace std;
 
 void Lexer::AbortTransaction(long position)
 {
+    // A stream's position is -1 if the transaction began at EOF, nothing could have been read since
+    if(m_profiler != nullptr && position != -1)
+    {
+        m_profiler->GaveBack(m_consumedCharacters - position);
+    }
+
     m_transactionDepth--;
     FailFastAssert(m_transactionDepth >= 0);
     Seek(position);
@@ -25,22 +34,35 @@ void Lexer::CommitTransaction(long position)
     // The Reader must detect if we are aborting out of order, but we can do a simple check here
     m_transactionDepth--;
     FailFastAssert(m_transactionDepth >= 0);
+
+    // Transactions this far out are things like the items in a repetition that makes up the whole document.  Once one commits, 
+    // the parser only goes back behind it if the document rule fails, so don't keep memoized rules for back there
+    if(m_transactionDepth <= MemoWindowDepth && m_ruleMemo.size() > 0)
+    {
+        m_ruleMemo.EvictBefore(m_consumedCharacters);
+    }
+}
+
+void Lexer::BeginMemo(long &savedDeepestFailure, const char *&savedErrorMessage)
+{
+    // Start with no failure so that what is left afterwards is exactly what the rule reported
+    savedDeepestFailure = m_deepestFailure;
+    savedErrorMessage = m_errorMessage;
+    m_deepestFailure = -1;
+    m_errorMessage = "";
 }
 
 bool Lexer::Eof() 
 { 
-    return Peek()->symbolID() == SymbolID::eof; 
+    char character;
+    return !PeekChar(character);
 }
 
 // Used to report where an error occurred
-void Lexer::GetLineAndColumn(int charPosition, shared_ptr<istream> stream, int &lineCount, int &columnCount, string *lineString)
+// nextCharacter(character) returns false when there is nothing left to read
+template<class NextCharacterFunction>
+static void ScanLineAndColumn(int charPosition, NextCharacterFunction nextCharacter, int &lineCount, int &columnCount, string *lineString)
 {
-    if(!stream->good())
-    {
-        stream->clear();
-    }
-    stream->seekg(0);
-
     char character;
     lineCount = 1;
     columnCount = 0;
@@ -51,9 +73,8 @@ void Lexer::GetLineAndColumn(int charPosition, shared_ptr<istream> stream, int &
     
     string lastLine;
     string nextLine;
-    while(charPosition > charCount && stream->good())
+    while(charPosition > charCount && nextCharacter(character))
     {
-        character = stream->get();
         result.push_back(character);
         charCount++;
 
@@ -87,65 +108,360 @@ void Lexer::GetLineAndColumn(int charPosition, shared_ptr<istream> stream, int &
     }
 }
 
+void Lexer::EndMemo(MemoEntry &entry, shared_ptr<Symbol> result, long savedDeepestFailure, const char *savedErrorMessage)
+{
+    entry.result = result;
+    entry.endPosition = m_consumedCharacters;
+    entry.deepestFailure = m_deepestFailure;
+    entry.failureMessage = m_errorMessage;
+
+    // Put back the failure from before the rule and then report the rule's failure on top of it
+    m_deepestFailure = savedDeepestFailure;
+    m_errorMessage = savedErrorMessage;
+    if(entry.deepestFailure != -1 && entry.deepestFailure >= m_deepestFailure)
+    {
+        m_deepestFailure = entry.deepestFailure;
+        m_errorMessage = entry.failureMessage;
+    }
+}
+
+void Lexer::GetLineAndColumn(int charPosition, shared_ptr<istream> stream, int &lineCount, int &columnCount, string *lineString)
+{
+    if(!stream->good())
+    {
+        stream->clear();
+    }
+    stream->seekg(0);
+
+    ScanLineAndColumn(charPosition, 
+        [&](char &character)
+        {
+            if(!stream->good())
+            {
+                return false;
+            }
+
+            character = stream->get();
+            return true;
+        }, 
+        lineCount, columnCount, lineString);
+}
+
+void Lexer::GetLineAndColumn(int charPosition, const char *buffer, long bufferLength, int &lineCount, int &columnCount, string *lineString)
+{
+    long position = 0;
+    ScanLineAndColumn(charPosition, 
+        [&](char &character)
+        {
+            if(position >= bufferLength)
+            {
+                return false;
+            }
+
+            character = buffer[position++];
+            return true;
+        }, 
+        lineCount, columnCount, lineString);
+}
+
+void Lexer::GetLineAndColumn(int charPosition, int &lineCount, int &columnCount, string *lineString)
+{
+    if(charPosition > m_indexedCharacters)
+    {
+        if(m_buffer != nullptr)
+        {
+            IndexBufferThrough(min((long) charPosition, m_bufferLength));
+        }
+        else
+        {
+            // Never read that far so it isn't indexed yet, read on from the end of the index instead of rescanning from 0
+            IndexStreamThrough(charPosition);
+        }
+    }
+
+    // lineStarts are the offsets just after each "\r\n", find how many are at or before charPosition
+    long lineIndex = upper_bound(m_lineStarts.begin(), m_lineStarts.end(), (long) charPosition) - m_lineStarts.begin();
+    long lastLineStart = lineIndex > 0 ? m_lineStarts[lineIndex - 1] : 0;
+    lineCount = (int) lineIndex + 1;
+    columnCount = charPosition - (int) lastLineStart + 1;
+    
+    if(lineString != nullptr)
+    {
+        // Same text as the stream scan: the whole previous line and the current line up to charPosition,
+        // unless charPosition is right at the start of a line in which case it is the previous line again
+        long previousLineStart = lineIndex > 1 ? m_lineStarts[lineIndex - 2] : 0;
+        string lastLine = lineIndex > 0 ? Text(previousLineStart, lastLineStart) : "";
+        string line = (lineIndex > 0 && lastLineStart == charPosition) ? lastLine : Text(lastLineStart, charPosition);
+        *lineString = "Prev: " + lastLine + "\r\n Line: " + line;
+    }
+}
+
+void Lexer::IndexBufferThrough(long position)
+{
+    FailFastAssert(m_buffer != nullptr && position <= m_bufferLength);
+    long consumedCharacters = m_consumedCharacters;
+    while(m_indexedCharacters < position)
+    {
+        m_consumedCharacters = m_indexedCharacters + 1;
+        IndexCharacter(m_buffer[m_indexedCharacters]);
+    }
+
+    m_consumedCharacters = consumedCharacters;
+}
+
+// Reads ahead from the end of the index up to position, or to EOF if that comes first, then goes back to where it was
+void Lexer::IndexStreamThrough(long position)
+{
+    FailFastAssert(m_stream != nullptr);
+    // Position() doesn't work once the stream has hit EOF
+    long consumedCharacters = m_consumedCharacters;
+    Seek(m_indexedCharacters);
+    char character;
+    while(m_indexedCharacters < position && m_stream->get(character))
+    {
+        m_consumedCharacters = m_indexedCharacters + 1;
+        IndexCharacter(character);
+    }
+
+    Seek(consumedCharacters);
+}
+
 void Lexer::Open(shared_ptr<istream> stream)
 {
+    m_buffer = nullptr;
+    m_bufferLength = 0;
+    m_bufferOwner = nullptr;
     m_consumedCharacters = 0;
     m_deepestFailure = -1;
     m_errorMessage = "";
+    m_keptErrorMessages.clear();
+    m_lineStarts.clear();
+    m_indexedCharacters = 0;
+    m_indexedLastWasCR = false;
+    m_memo.Clear();
+    m_ruleMemo.Clear();
     m_stream = stream;
     m_transactionDepth = 0;
 }
 
+void Lexer::Open(const char *buffer, long bufferLength, shared_ptr<void> bufferOwner)
+{
+    FailFastAssert(buffer != nullptr && bufferLength >= 0);
+    m_buffer = buffer;
+    m_bufferLength = bufferLength;
+    m_bufferOwner = bufferOwner;
+    m_consumedCharacters = 0;
+    m_deepestFailure = -1;
+    m_errorMessage = "";
+    m_keptErrorMessages.clear();
+    m_lineStarts.clear();
+    m_indexedCharacters = 0;
+    m_indexedLastWasCR = false;
+    m_memo.Clear();
+    m_ruleMemo.Clear();
+    m_stream = nullptr;
+    m_transactionDepth = 0;
+}
+
+void Lexer::Open(shared_ptr<string> buffer)
+{
+    Open(buffer->c_str(), (long) buffer->size(), buffer);
+}
+
 shared_ptr<Symbol> Lexer::Peek()
 {
-    char character = m_stream->peek();
+    char character;
+    if(PeekChar(character))
+    {
+        return LexerSymbol::ForCharacter(character);
+    }
+    else
+    {
+        return EofSymbol::defaultValue;
+    }
+}
+
+bool Lexer::PeekStreamChar(char &character)
+{
+    character = m_stream->peek();
     if(!(character == EOF))
     {
-        TraceString3("{0}Lexer::Peek: '{1}', Consumed: {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+        ParserTraceString3("{0}Lexer::Peek: '{1}', Consumed: {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
             string((size_t) (TransactionDepth() * 3), ' '), character, m_consumedCharacters);
-        return shared_ptr<LexerSymbol>(new LexerSymbol(character));
+        return true;
     }
     else
     {
-        TraceString2("{0}Lexer::Peek: '<EOF>', Consumed: {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic,
+        ParserTraceString2("{0}Lexer::Peek: '<EOF>', Consumed: {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic,
              string((size_t) (TransactionDepth() * 3), ' '), m_consumedCharacters);
-        return EofSymbol::defaultValue;
+        return false;
     }
 }
 
 shared_ptr<Symbol> Lexer::Read()
 {
     char character;
+    if(ReadChar(character))
+    {
+        return LexerSymbol::ForCharacter(character);
+    }
+    else
+    {
+        return EofSymbol::defaultValue;
+    }
+}
+
+bool Lexer::ReadStreamChar(char &character)
+{
     if(m_stream->read(&character, 1))
     {
         m_consumedCharacters++;
-        TraceString3("{0}Lexer::Read: '{1}', Consumed: {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+        if(m_consumedCharacters > m_indexedCharacters)
+        {
+            IndexCharacter(character);
+        }
+
+        ParserTraceString3("{0}Lexer::Read: '{1}', Consumed: {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
             string((size_t) (TransactionDepth() * 3), ' '), character, m_consumedCharacters);
-        return shared_ptr<LexerSymbol>(new LexerSymbol(character));
+        return true;
     }
     else
     {
-        TraceString2("{0}Lexer::Read: '<EOF>', Consumed: {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic,
+        ParserTraceString2("{0}Lexer::Read: '<EOF>', Consumed: {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic,
              string((size_t) (TransactionDepth() * 3), ' '), m_consumedCharacters);
-        return EofSymbol::defaultValue;
+        return false;
+    }
+}
+
+// Scans the characters in scanner's class straight out of the buffer without creating a Symbol for each one. Unlike ReadSpan()
+// the first character that isn't in the class isn't consumed, it is left for whatever rule comes next
+long Lexer::ReadRun(const CharRunScanner &scanner, long maxLength, const char *&run)
+{
+    if(m_buffer == nullptr)
+    {
+        run = nullptr;
+        return 0;
+    }
+
+    run = m_buffer + m_consumedCharacters;
+    long length = scanner.Scan(run, run + min(maxLength, m_bufferLength - m_consumedCharacters));
+    m_consumedCharacters += length;
+    if(m_consumedCharacters > m_indexedCharacters)
+    {
+        IndexBufferThrough(m_consumedCharacters);
+    }
+
+    return length;
+}
+
+// Reads characters as long as they match span, stopping after length characters. Returns how many matched.
+// If it stops because a character didn't match, that character is consumed too and returned in mismatch (and foundEof is false) 
+// so that callers see the same position as if they had read and compared each character themselves.
+// Only characters that are character symbols (see SymbolID::IsCharacterSymbol) match, just like comparing Symbols would.
+long Lexer::ReadSpan(const char *span, long length, bool &foundEof, char &mismatch)
+{
+    foundEof = false;
+    long matched = 0;
+    if(m_buffer != nullptr)
+    {
+        long available = min(length, m_bufferLength - m_consumedCharacters);
+        const char *current = m_buffer + m_consumedCharacters;
+        while(matched < available && current[matched] == span[matched] && SymbolID::IsCharacterSymbol(span[matched]))
+        {
+            matched++;
+        }
+
+        if(matched < available)
+        {
+            // Consume the character that didn't match
+            mismatch = current[matched];
+            m_consumedCharacters += matched + 1;
+        }
+        else
+        {
+            m_consumedCharacters += matched;
+            foundEof = matched < length;
+        }
+
+        if(m_consumedCharacters > m_indexedCharacters)
+        {
+            IndexBufferThrough(m_consumedCharacters);
+        }
+
+        return matched;
+    }
+
+    char character;
+    while(matched < length)
+    {
+        if(!ReadChar(character))
+        {
+            foundEof = true;
+            break;
+        }
+        else if(character == span[matched] && SymbolID::IsCharacterSymbol(character))
+        {
+            matched++;
+        }
+        else
+        {
+            mismatch = character;
+            break;
+        }
     }
+
+    return matched;
 }
 
-void Lexer::ReportFailure(const string &errorMessage)
+void Lexer::ReplayMemo(const MemoEntry &entry)
+{
+    if(entry.deepestFailure != -1 && entry.deepestFailure >= m_deepestFailure)
+    {
+        ParserTraceString2("{0}Lexer::ReportFailure New deepest failure at char {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+            string((size_t) (TransactionDepth() * 3), ' '), entry.deepestFailure);
+        m_deepestFailure = entry.deepestFailure;
+        m_errorMessage = entry.failureMessage;
+    }
+
+    if(entry.result != nullptr)
+    {
+        Seek(entry.endPosition);
+    }
+}
+
+const char *Lexer::KeepErrorMessage(const string &errorMessage)
+{
+    // Nodes in a set don't move so the pointer stays good until the set is cleared
+    return m_keptErrorMessages.insert(errorMessage).first->c_str();
+}
+
+void Lexer::ReportFailure(const char *errorMessage)
+{
+    ReportFailureAt(m_consumedCharacters, errorMessage);
+}
+
+void Lexer::ReportFailureAt(long position, const char *errorMessage)
 {
     // Assume the last one to hit this length is going to be the best message because
     // often a token will fail first (like whitespace) and then the good error message token will fail
-    if(m_consumedCharacters >= m_deepestFailure)
+    if(position >= m_deepestFailure)
     {
-        TraceString2("{0}Lexer::ReportFailure New deepest failure at char {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-            string((size_t) (TransactionDepth() * 3), ' '), m_consumedCharacters);
-        m_deepestFailure = m_consumedCharacters;
+        ParserTraceString2("{0}Lexer::ReportFailure New deepest failure at char {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+            string((size_t) (TransactionDepth() * 3), ' '), position);
+        m_deepestFailure = position;
         m_errorMessage = errorMessage;
     }
 }
 
 void Lexer::Seek(long position) 
 {
+    if(m_buffer != nullptr)
+    {
+        FailFastAssert(position >= 0 && position <= m_bufferLength);
+        m_consumedCharacters = position;
+        return;
+    }
+
     if(!m_stream->good())
     {
         m_stream->clear();
@@ -160,8 +476,51 @@ void Lexer::Seek(long position)
     FailFastAssert(Position() == position);
 }
 
-int Lexer::TransactionDepth()
+// Returns the characters in [start, end) without moving the current position
+string Lexer::Text(long start, long end)
+{
+    end = max(start, end);
+    if(m_buffer != nullptr)
+    {
+        end = min(end, m_bufferLength);
+        return string(m_buffer + start, max(0L, end - start));
+    }
+    else
+    {
+        // Position() doesn't work once the stream has hit EOF
+        long position = m_consumedCharacters;
+        string text((size_t) (end - start), '\0');
+        Seek(start);
+        m_stream->read(&text[0], end - start);
+        text.resize((size_t) m_stream->gcount());
+        Seek(position);
+        return text;
+    }
+}
+
+void Lexer::CreateMatched()
 {
-    return m_transactionDepth;
+    if(m_matched == nullptr)
+    {
+        // Delete so that it flattens to nothing. It belongs to this Lexer since TryParseRule() sets its span
+        m_matched = shared_ptr<Symbol>(new Symbol(SymbolID::matched, FlattenType::Delete));
+    }
 }
 
+void Lexer::eventHandler(ParseEventHandler *value)
+{
+    m_eventHandler = value;
+    if(m_eventHandler != nullptr)
+    {
+        CreateMatched();
+    }
+}
+
+void Lexer::validate(bool value)
+{
+    m_validate = value;
+    if(m_validate)
+    {
+        CreateMatched();
+    }
+}
@@ -1,21 +1,43 @@
 #pragma once
+#include "FXPlatform/NanoTrace.h"
+#include "ParserTrace.h"
 #include "FXPlatform/Utilities.h"
+#include "MemoTable.h"
 #include <list>
+#include <set>
+#include <vector>
 
 namespace FXPlat
 {
+    class CharRunScanner;
     class LexerReader;
+    class ParseEventHandler;
+    class RuleProfiler;
     class Symbol;
+    class SymbolArena;
 
 	// This is a PEG (Parsing Expression Grammar) parser
     // The Lexer's job is to allow the parser to grab a character at a time
 	// from the stream that is opened via Open().  The parser then can combine
 	// them into larger symbols based on the parser's rules.
 	//
+	// The Lexer can read from either a std::istream or a contiguous buffer of bytes. The buffer
+	// form is much faster since reading a character is just an array index and transactions only
+	// need to save and restore the offset, but the whole document has to be in memory.
+	//
 	// The parser actually uses LexerReader (which wraps Lexer) because LexerReader 
 	// automatically handles putting tokens back into the Lexer if they aren't consumed.
 	// See comments there for more details.
 	//
+	// As characters are read for the first time the Lexer records where each line starts so that
+	// GetLineAndColumn() can turn any offset it has read into a line and column with a binary search 
+	// instead of rereading the document.  Lines are ended by "\r\n".
+	//
+	// The Lexer also holds the memo table used when "Packrat" memoization is turned on with memoize(true).
+	// The rules then record the result of each rule they parse at each position and replay it if the parser
+	// backtracks and tries the same rule at the same position again. See TryParseRule() in Parser.h.
+	// Rules wrapped in Memoized<> are always memoized, in a separate table with a fixed size (see WindowedMemoTable)
+	//
 	// Lexer also allows the parser to record rules that fail, and keeps the one that went
 	// deepest into the tree. That's because the deepest failure is, surprisingly often,
 	// the actual error in the document being parsed. Thus, that's the error returned.
@@ -24,35 +46,191 @@ namespace FXPlat
     public:
         friend LexerReader;
 
-        Lexer() {}
+        Lexer() :
+            m_buffer(nullptr),
+            m_bufferLength(0),
+            m_consumedCharacters(0),
+            m_deepestFailure(-1),
+            m_errorMessage(""),
+            m_eventHandler(nullptr),
+            m_indexedCharacters(0),
+            m_indexedLastWasCR(false),
+            m_memoize(false),
+            m_transactionDepth(0),
+            m_validate(false)
+        {
+        }
 
         long consumedCharacters() { return m_consumedCharacters; }
         int DeepestFailure() { return (int) m_deepestFailure; }
         bool Eof();
         std::string ErrorMessage() { return m_errorMessage; }
+        // Works for any offset in the document, e.g. where a Symbol started. linestring gets the previous line and the 
+        // current line up to charPosition
+        void GetLineAndColumn(int charPosition, int &lineCount, int &columnCount, std::string *linestring = nullptr);
         static void GetLineAndColumn(int charPosition, std::shared_ptr<std::istream> stream, int &lineCount, int &columnCount, std::string *linestring = nullptr);
+        static void GetLineAndColumn(int charPosition, const char *buffer, long bufferLength, int &lineCount, int &columnCount, std::string *linestring = nullptr);
         void Open(std::shared_ptr<std::istream> stream);
+        // buffer must stay alive and unchanged until the Lexer is done with it, pass whatever owns it
+        // as bufferOwner to have the Lexer keep it alive. TokenSymbols point into the buffer too and also keep bufferOwner alive
+        void Open(const char *buffer, long bufferLength, std::shared_ptr<void> bufferOwner = nullptr);
+        void Open(std::shared_ptr<std::string> buffer);
         std::shared_ptr<Symbol> Peek();
-        void ReportFailure(const std::string &errorMessage);
-        int TransactionDepth();
+        // Same as Peek() but just returns the character, returns false at EOF
+        bool PeekChar(char &character)
+        {
+            if(m_buffer == nullptr)
+            {
+                return PeekStreamChar(character);
+            }
+
+            if(m_consumedCharacters < m_bufferLength)
+            {
+                character = m_buffer[m_consumedCharacters];
+                ParserTraceString3("{0}Lexer::Peek: '{1}', Consumed: {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    std::string((size_t) (TransactionDepth() * 3), ' '), character, m_consumedCharacters);
+                return true;
+            }
+            else
+            {
+                ParserTraceString2("{0}Lexer::Peek: '<EOF>', Consumed: {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic,
+                     std::string((size_t) (TransactionDepth() * 3), ' '), m_consumedCharacters);
+                return false;
+            }
+        }
 
+        // errorMessage is kept as a pointer so it needs to live as long as the Lexer, normally it is a static string.
+        // Use KeepErrorMessage() for anything else
+        void ReportFailure(const char *errorMessage);
+        // Same as ReportFailure() but for a failure at position instead of the current position
+        void ReportFailureAt(long position, const char *errorMessage);
+        // Returns a copy of errorMessage that lives until the next Open()
+        const char *KeepErrorMessage(const std::string &errorMessage);
+        int TransactionDepth() { return m_transactionDepth; }
+
+        // Packrat memoization, off by default. Open() clears the memo table but leaves this setting alone
+        bool memoize() { return m_memoize; }
+        void memoize(bool value) { m_memoize = value; }
+        MemoTable &memo() { return m_memo; }
+        // Records what each rule does while parsing when set, see RuleProfiler. Open() leaves this alone
+        RuleProfiler *profiler() { return m_profiler.get(); }
+        void profiler(std::shared_ptr<RuleProfiler> value) { m_profiler = value; }
+        // The Symbols the rules create come from this when it is set, see SymbolArena. Open() leaves this alone
+        SymbolArena *arena() { return m_arena.get(); }
+        void arena(std::shared_ptr<SymbolArena> value) { m_arena = value; }
+        // When set the rules only check that the document parses: they don't build any Symbols and each one that succeeds
+        // returns matched() instead. The failures reported are the same. Open() leaves this alone
+        bool validate() { return m_validate; }
+        void validate(bool value);
+        // What rules that succeed return instead of a Symbol while validating, or when they already sent their part of the tree
+        // to eventHandler()
+        const std::shared_ptr<Symbol> &matched() { return m_matched; }
+        // When set the parse tree is sent to it as the rules parse it, see ParseEventHandler. It must outlive the parse and isn't
+        // used while validating. Open() leaves this alone
+        ParseEventHandler *eventHandler() { return m_eventHandler; }
+        void eventHandler(ParseEventHandler *value);
+        // Used by Memoized<> rules whether or not memoize() is on
+        WindowedMemoTable &ruleMemo() { return m_ruleMemo; }
+        // Called before and after parsing a rule that is being memoized so that the failures it reports can be recorded in entry
+        // savedDeepestFailure and savedErrorMessage hold the failure from before the rule while it is parsed
+        void BeginMemo(long &savedDeepestFailure, const char *&savedErrorMessage);
+        void EndMemo(MemoEntry &entry, std::shared_ptr<Symbol> result, long savedDeepestFailure, const char *savedErrorMessage);
+        // Does what the rule did when entry was recorded: reports the same failure and consumes the same characters
+        void ReplayMemo(const MemoEntry &entry);
+
+        const char *buffer() { return m_buffer; }
+        long bufferLength() { return m_bufferLength; }
+        std::shared_ptr<void> bufferOwner() { return m_bufferOwner; }
         std::shared_ptr<std::istream> stream() { return m_stream; }
+        // The characters between offsets start and end in the document (clipped to the end of it)
+        std::string Text(long start, long end);
         
     private:
+        // Commits that leave this few transactions open move the window of m_ruleMemo forward, see CommitTransaction()
+        static const int MemoWindowDepth = 2;
+
 		// Used by LexerReader to create transactions when symbols are consumed
 		// Aborting them puts the symbols back into the Lexer so the next rule can try
 		// to consume them.
         void AbortTransaction(long position);
         long BeginTransaction();
         void CommitTransaction(long position);
-        long Position() { return (long) m_stream->tellg(); }
+        long Position() { return m_buffer != nullptr ? m_consumedCharacters : (long) m_stream->tellg(); }
         void Seek(long position);
         std::shared_ptr<Symbol> Read();
+        // Same as Read() but just returns the character, returns false (and doesn't move) at EOF
+        bool ReadChar(char &character)
+        {
+            if(m_buffer == nullptr)
+            {
+                return ReadStreamChar(character);
+            }
+
+            if(m_consumedCharacters < m_bufferLength)
+            {
+                character = m_buffer[m_consumedCharacters++];
+                if(m_consumedCharacters > m_indexedCharacters)
+                {
+                    IndexCharacter(character);
+                }
+
+                ParserTraceString3("{0}Lexer::Read: '{1}', Consumed: {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    std::string((size_t) (TransactionDepth() * 3), ' '), character, m_consumedCharacters);
+                return true;
+            }
+            else
+            {
+                ParserTraceString2("{0}Lexer::Read: '<EOF>', Consumed: {1}", SystemTraceType::Parsing, TraceDetail::Diagnostic,
+                     std::string((size_t) (TransactionDepth() * 3), ' '), m_consumedCharacters);
+                return false;
+            }
+        }
+
+        // Reads characters for as long as they are in scanner's class, up to maxLength of them. run points to
+        // the characters read. Only reads from a buffer, always returns 0 for a stream so the rule has to read them one at a time
+        long ReadRun(const CharRunScanner &scanner, long maxLength, const char *&run);
+        long ReadSpan(const char *span, long length, bool &foundEof, char &mismatch);
+
+        // Called for each character the first time it is read, in order, so it can be added to the line index
+        void IndexCharacter(char character)
+        {
+            if(character == '\n' && m_indexedLastWasCR)
+            {
+                m_lineStarts.push_back(m_consumedCharacters);
+            }
+
+            m_indexedLastWasCR = character == '\r';
+            m_indexedCharacters = m_consumedCharacters;
+        }
+
+        void CreateMatched();
+        void IndexBufferThrough(long position);
+        void IndexStreamThrough(long position);
+        bool PeekStreamChar(char &character);
+        bool ReadStreamChar(char &character);
 
+        // Declared first so it is destroyed last: the memo tables hold Symbols that came from it
+        std::shared_ptr<SymbolArena> m_arena;
+        // When m_buffer is set the Lexer reads from it instead of m_stream and m_consumedCharacters is the cursor
+        const char *m_buffer;
+        long m_bufferLength;
+        std::shared_ptr<void> m_bufferOwner;
         long m_consumedCharacters;
         long m_deepestFailure;
-        std::string m_errorMessage;
+        const char *m_errorMessage;
+        ParseEventHandler *m_eventHandler;
+        std::set<std::string> m_keptErrorMessages;
+        std::shared_ptr<Symbol> m_matched;
+        // Offsets just after each "\r\n" in the first m_indexedCharacters characters
+        std::vector<long> m_lineStarts;
+        long m_indexedCharacters;
+        bool m_indexedLastWasCR;
+        MemoTable m_memo;
+        bool m_memoize;
+        std::shared_ptr<RuleProfiler> m_profiler;
+        WindowedMemoTable m_ruleMemo;
         std::shared_ptr<std::istream> m_stream;
         int m_transactionDepth;
+        bool m_validate;
     };
 }
@@ -3,11 +3,16 @@
 #include "Parser.h"
 using namespace FXPlat;
 
-LexerReader::LexerReader(shared_ptr<Lexer> lexer) :
+LexerReader::LexerReader(Lexer &lexer) :
     m_originalPosition(-2),
-    m_transactionDepth(-1)
+    m_transactionDepth(-1),
+    m_lexer(&lexer)
+{
+};
+
+LexerReader::LexerReader(shared_ptr<Lexer> lexer) :
+    LexerReader(*lexer)
 {
-    m_lexer = lexer;
 };
 
 LexerReader::~LexerReader()
@@ -1,4 +1,5 @@
 #pragma once
+#include "FXPlatform/FailFast.h"
 #include "Lexer.h"
 
 namespace FXPlat
@@ -15,6 +16,8 @@ namespace FXPlat
     class LexerReader
     {
     public:
+        LexerReader(Lexer &lexer);
+        // lexer has to stay alive while the LexerReader is used
         LexerReader(std::shared_ptr<Lexer> lexer);
         ~LexerReader();
 
@@ -26,6 +29,33 @@ namespace FXPlat
         std::shared_ptr<Symbol> Read();
         unsigned short Read(std::shared_ptr<Symbol> &symbol);
 
+        // Fast versions of Peek() and Read() for rules that only care about the character and not a Symbol
+        // They return false at EOF
+        bool PeekChar(char &character)
+        {
+            return m_lexer->PeekChar(character);
+        }
+
+        bool ReadChar(char &character)
+        {
+            FailFastAssert(m_originalPosition != -2);
+            return m_lexer->ReadChar(character);
+        }
+
+        // Reads characters as long as they are in scanner's class, see Lexer::ReadRun()
+        long ReadRun(const CharRunScanner &scanner, long maxLength, const char *&run)
+        {
+            FailFastAssert(m_originalPosition != -2);
+            return m_lexer->ReadRun(scanner, maxLength, run);
+        }
+
+        // Reads characters as long as they match span, see Lexer::ReadSpan()
+        long ReadSpan(const char *span, long length, bool &foundEof, char &mismatch)
+        {
+            FailFastAssert(m_originalPosition != -2);
+            return m_lexer->ReadSpan(span, length, foundEof, mismatch);
+        }
+
     private:
 		// This class should always be a local stack based class, (i.e. never created with new()) because otherwise it could mess
 		// up the ordering of tokens when it gets destructed
@@ -34,6 +64,6 @@ namespace FXPlat
 
         long m_originalPosition;
         int m_transactionDepth;
-        std::shared_ptr<Lexer> m_lexer;
+        Lexer *m_lexer;
     };
 }
@@ -0,0 +1,83 @@
+#include "MemoTable.h"
+#include "Parser.h"
+using namespace FXPlat;
+using namespace std;
+
+MemoEntry &MemoTable::Add(const void *rule, long position)
+{
+    Key key;
+    key.rule = rule;
+    key.position = position;
+    return m_entries[key];
+}
+
+void MemoTable::Clear()
+{
+    m_entries.clear();
+}
+
+MemoEntry *MemoTable::Find(const void *rule, long position)
+{
+    Key key;
+    key.rule = rule;
+    key.position = position;
+    unordered_map<Key, MemoEntry, KeyHash>::iterator found = m_entries.find(key);
+    return found == m_entries.end() ? nullptr : &found->second;
+}
+
+MemoEntry &WindowedMemoTable::Add(const void *rule, long position)
+{
+    // Make room by dropping the entries furthest behind
+    while(m_count >= m_maxEntries && m_entries.size() > 0)
+    {
+        m_count -= m_entries.begin()->second.size();
+        m_entries.erase(m_entries.begin());
+    }
+
+    PositionEntries &entries = m_entries[position];
+    for(PositionEntries::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+    {
+        if(iter->first == rule)
+        {
+            return iter->second;
+        }
+    }
+
+    m_count++;
+    entries.push_back(pair<const void *, MemoEntry>(rule, MemoEntry()));
+    return entries.back().second;
+}
+
+void WindowedMemoTable::Clear()
+{
+    m_entries.clear();
+    m_count = 0;
+}
+
+void WindowedMemoTable::EvictBefore(long position)
+{
+    map<long, PositionEntries>::iterator end = m_entries.lower_bound(position);
+    for(map<long, PositionEntries>::iterator iter = m_entries.begin(); iter != end; ++iter)
+    {
+        m_count -= iter->second.size();
+    }
+
+    m_entries.erase(m_entries.begin(), end);
+}
+
+MemoEntry *WindowedMemoTable::Find(const void *rule, long position)
+{
+    map<long, PositionEntries>::iterator found = m_entries.find(position);
+    if(found != m_entries.end())
+    {
+        for(PositionEntries::iterator iter = found->second.begin(); iter != found->second.end(); ++iter)
+        {
+            if(iter->first == rule)
+            {
+                return &iter->second;
+            }
+        }
+    }
+
+    return nullptr;
+}
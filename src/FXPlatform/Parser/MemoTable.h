@@ -0,0 +1,91 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FXPlat
+{
+    class Symbol;
+
+    // Everything a rule did when it was parsed at a position, so that the parser can replay it instead of
+    // parsing the rule again when it backtracks to the same place
+    class MemoEntry
+    {
+    public:
+        // nullptr if the rule failed, in which case it didn't consume anything
+        std::shared_ptr<Symbol> result;
+        long endPosition;
+        // The failures reported while parsing the rule boil down to the deepest one and the last message reported
+        // there, see Lexer::ReportFailure(). deepestFailure is -1 if none were reported
+        long deepestFailure;
+        const char *failureMessage;
+        // The messages a rule reports can depend on the error message passed to it, so the entry is only used
+        // if the same message is passed again. Messages are static strings so comparing the pointers is enough
+        const char *errorMessage;
+    };
+
+    // The "Packrat" memo table: remembers the MemoEntry for each rule and position that was parsed.
+    // Rules are identified by the address of something unique to the rule, see RuleIdentity in Parser.h
+    class MemoTable
+    {
+    public:
+        MemoEntry &Add(const void *rule, long position);
+        void Clear();
+        // Returns nullptr if the rule hasn't been parsed at position
+        MemoEntry *Find(const void *rule, long position);
+        size_t size() { return m_entries.size(); }
+
+    private:
+        class Key
+        {
+        public:
+            bool operator==(const Key &other) const { return rule == other.rule && position == other.position; }
+            const void *rule;
+            long position;
+        };
+
+        class KeyHash
+        {
+        public:
+            size_t operator()(const Key &key) const
+            {
+                return std::hash<const void *>()(key.rule) ^ (std::hash<long>()(key.position) * 31);
+            }
+        };
+
+        std::unordered_map<Key, MemoEntry, KeyHash> m_entries;
+    };
+
+    // The memo table used by Memoized<> rules. It holds at most maxEntries entries so memory stays fixed no matter how big 
+    // the document is.  Entries are kept in position order so the ones furthest behind the parser are the ones that get evicted:
+    // when it is full, and when EvictBefore() is called because the parser has committed past them. 
+    // Evicting an entry is always safe, the rule just gets parsed again if it is needed
+    class WindowedMemoTable
+    {
+    public:
+        static const size_t DefaultMaxEntries = 16384;
+
+        WindowedMemoTable() :
+            m_count(0),
+            m_maxEntries(DefaultMaxEntries)
+        {
+        }
+
+        MemoEntry &Add(const void *rule, long position);
+        void Clear();
+        void EvictBefore(long position);
+        MemoEntry *Find(const void *rule, long position);
+        size_t maxEntries() { return m_maxEntries; }
+        void maxEntries(size_t value) { m_maxEntries = value; }
+        size_t size() { return m_count; }
+
+    private:
+        typedef std::vector<std::pair<const void *, MemoEntry>> PositionEntries;
+
+        size_t m_count;
+        std::map<long, PositionEntries> m_entries;
+        size_t m_maxEntries;
+    };
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Lexer.h"
+#include "ParseEventHandler.h"
+
+namespace FXPlat
+{
+	// Everything a rule needs while it is parsing. Rules pass it to each other by reference so that calling a rule
+	// doesn't copy a shared_ptr<Lexer> (an atomic increment and decrement) every time, which adds up since each character
+	// goes through several rules.
+	//
+	// It gives the rules the Lexer they are reading from along with the state kept for the whole parse: the memo tables
+	// (see TryParseRule() in Parser.h), the RuleProfiler and the deepest failure that becomes the error. Those all live in the Lexer
+	// so they are still there after parsing. The only state it keeps itself is which rules are sending events, which is only
+	// needed while parsing.
+    class ParseContext
+    {
+    public:
+        explicit ParseContext(Lexer &lexer) :
+            m_cutAllowed(false),
+            m_cutFailed(false),
+            m_cutNext(false),
+            m_eventPosition(lexer.consumedCharacters()),
+            m_lexer(lexer),
+            m_streamNext(false),
+            m_streaming(lexer.eventHandler() != nullptr && !lexer.validate())
+        {
+        }
+
+        Lexer &lexer() { return m_lexer; }
+
+        // Error state
+        void ReportFailure(const char *errorMessage) { m_lexer.ReportFailure(errorMessage); }
+        void ReportFailureAt(long position, const char *errorMessage) { m_lexer.ReportFailureAt(position, errorMessage); }
+
+        // Memo tables
+        bool memoize() { return m_lexer.memoize(); }
+        MemoTable &memo() { return m_lexer.memo(); }
+        WindowedMemoTable &ruleMemo() { return m_lexer.ruleMemo(); }
+
+        // nullptr unless profiling
+        RuleProfiler *profiler() { return m_lexer.profiler(); }
+
+        // See Lexer::validate()
+        bool validate() { return m_lexer.validate(); }
+
+        // Events (see ParseEventHandler). A rule that is streaming() sends its part of the tree as it parses it and returns
+        // Lexer::matched() instead of a Symbol. Rules are only streaming if nothing can backtrack over them so it has to be the
+        // first rule or one whose parent is streaming and asked for it with StreamNextRule() because the parent fails if it does.
+        // A rule has to check before it calls any other rules
+        bool streaming() { return m_streaming; }
+        void StreamNextRule() { m_streamNext = true; }
+        // An AndExpression with a CutExpression in it starts streaming once it gets past the cut if its parent allowed it with
+        // AllowCutInNextRule(). Only parents that nothing can backtrack over do: a streaming repeat, or an OrExpression that is
+        // streaming or allowed to cut itself. Failing after the cut fails the whole parse: the rules that allowed it see cutFailed()
+        // and fail too
+        bool cutAllowed() { return m_cutAllowed; }
+        void AllowCutInNextRule() { m_cutNext = true; }
+        bool cutFailed() { return m_cutFailed; }
+        void CutFailed() { m_cutFailed = true; }
+        // Called by TryParseRule() as each rule starts
+        void StartRule()
+        {
+            m_cutAllowed = m_cutNext;
+            m_cutNext = false;
+            m_streaming = m_streamNext;
+            m_streamNext = false;
+        }
+
+        // A rule's Enter() waits until something is sent for its children, if nothing is it is sent as a Token() instead so the events
+        // are the same as ParseEventHandler::Send() would send for the Symbol
+        void SendEnter(unsigned short symbolID, long start)
+        {
+            m_pendingEnters.push_back(std::make_pair(symbolID, start));
+        }
+
+        void SendLeave(unsigned short symbolID, long start, long length)
+        {
+            if(m_pendingEnters.size() > 0)
+            {
+                m_pendingEnters.pop_back();
+                SendPendingEnters();
+                m_lexer.eventHandler()->Token(symbolID, FlattenType::None, start, length, "");
+            }
+            else
+            {
+                m_lexer.eventHandler()->Leave(symbolID, start, length);
+            }
+
+            m_eventPosition = start + length;
+        }
+
+        // symbol is what a rule returned, see ParseEventHandler::Send()
+        void Send(Symbol *symbol)
+        {
+            if(ParseEventHandler::SendsNothing(symbol))
+            {
+                return;
+            }
+
+            SendPendingEnters();
+            m_lexer.eventHandler()->Send(symbol, m_eventPosition);
+        }
+
+    private:
+        void SendPendingEnters()
+        {
+            for(const std::pair<unsigned short, long> &enter : m_pendingEnters)
+            {
+                m_lexer.eventHandler()->Enter(enter.first, enter.second);
+                m_eventPosition = enter.second;
+            }
+
+            m_pendingEnters.clear();
+        }
+
+        bool m_cutAllowed;
+        bool m_cutFailed;
+        bool m_cutNext;
+        long m_eventPosition;
+        Lexer &m_lexer;
+        std::vector<std::pair<unsigned short, long>> m_pendingEnters;
+        bool m_streamNext;
+        bool m_streaming;
+    };
+
+	// Rules parse using a ParseContext. This gives a rule the TryParse(shared_ptr<Lexer>, ...) that code outside the parser
+	// (like Compiler) uses to start parsing, put it in every rule that has its own TryParse(ParseContext &, ...)
+	// The rules keep error messages as pointers, so the caller's message is copied into the Lexer first. Rules called
+	// with TryParseRule() get their span set there, this sets it for the first one
+    #define LexerTryParse() \
+        static std::shared_ptr<Symbol> TryParse(std::shared_ptr<Lexer> lexer, const std::string &errorMessage) \
+        { \
+            ParseContext context(*lexer); \
+            long position = lexer->consumedCharacters(); \
+            std::shared_ptr<Symbol> result = TryParse(context, lexer->KeepErrorMessage(errorMessage)); \
+            if(result != nullptr) \
+            { \
+                result->span(position, lexer->consumedCharacters() - position); \
+            } \
+            \
+            return result; \
+        }
+}
@@ -0,0 +1,91 @@
+#include "ParseEventHandler.h"
+#include "Parser.h"
+using namespace FXPlat;
+using namespace std;
+
+namespace
+{
+    // A Symbol whose children are being sent. SendTree() keeps its own stack of these instead of recursing, like FlatAst::Build()
+    class OpenSymbol
+    {
+    public:
+        OpenSymbol(Symbol *symbol, long start) :
+            nextChild(0),
+            start(start),
+            symbol(symbol)
+        {
+        }
+
+        size_t nextChild;
+        long start;
+        Symbol *symbol;
+    };
+}
+
+void ParseEventHandler::Send(Symbol *symbol, long &position)
+{
+    switch(symbol->flattenType())
+    {
+    case FlattenType::None:
+    case FlattenType::Token:
+        SendTree(symbol, position);
+        break;
+    case FlattenType::Delete:
+        break;
+    case FlattenType::Flatten:
+        // The children were already flattened when they were added
+        for(const shared_ptr<Symbol> &child : symbol->children())
+        {
+            SendTree(child.get(), position);
+        }
+        break;
+    }
+}
+
+bool ParseEventHandler::SendsNothing(Symbol *symbol)
+{
+    return symbol->flattenType() == FlattenType::Delete || (symbol->flattenType() == FlattenType::Flatten && symbol->children().size() == 0);
+}
+
+void ParseEventHandler::SendTree(Symbol *root, long &position)
+{
+    vector<OpenSymbol> open;
+    Symbol *next = root;
+    while(next != nullptr || open.size() > 0)
+    {
+        if(next == nullptr)
+        {
+            OpenSymbol &parent = open.back();
+            if(parent.nextChild < parent.symbol->children().size())
+            {
+                next = parent.symbol->children()[parent.nextChild++].get();
+            }
+            else
+            {
+                long length = parent.symbol->start() == -1 ? position - parent.start : parent.symbol->length();
+                Leave(parent.symbol->symbolID(), parent.start, length);
+                position = parent.start + length;
+                open.pop_back();
+            }
+
+            continue;
+        }
+
+        long start = next->start() == -1 ? position : next->start();
+        if(next->children().size() == 0)
+        {
+            string text = next->ToString();
+            long length = next->start() == -1 ? (long) text.size() : next->length();
+            Token(next->symbolID(), next->flattenType(), start, length, text);
+            position = start + length;
+        }
+        else
+        {
+            Enter(next->symbolID(), start);
+            position = start;
+            open.push_back(OpenSymbol(next, start));
+        }
+
+        next = nullptr;
+    }
+}
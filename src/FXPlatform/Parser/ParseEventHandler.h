@@ -0,0 +1,46 @@
+#pragma once
+#include "FlattenType.h"
+#include <string>
+
+namespace FXPlat
+{
+    class Symbol;
+
+	// Receives the parse tree as events instead of as Symbols: Enter() and Leave() around the children of each Symbol that has any
+	// and Token() for each one that doesn't, in document order. It is the same flattened tree Compiler hands to ProcessAst() (so only
+	// None and Token Symbols are in it) and each event has the symbolID and where the Symbol is in the document.
+	//
+	// A PEG parser can still backtrack over a rule that succeeded until the rules around it that could try something else are done,
+	// so a part of the tree is only sent once nothing can backtrack over it. The AndExpressions and repeats (e.g. ZeroOrMoreExpression)
+	// that the grammar starts with send their part as they parse: the Enter() for a rule before its children and each repetition as
+	// soon as it is parsed (see ParseContext::streaming()), and so do AndExpressions from their CutExpression on. Everything else is
+	// built as Symbols and sent when the rule that returned it is done. So the parser only has to keep the Symbols for one of those
+	// parts at a time, e.g. a stylesheet is sent one CSS rule at a time and an XML element is sent once its start tag is parsed, so
+	// only the open elements are built at once. Whatever the handler builds from the events is up to it. If the document turns out
+	// not to parse, the events already sent aren't taken back.
+	//
+	// Set Lexer::eventHandler() or Compiler::events() to use it. Override the events you want, the rest do nothing. Compiler derives
+	// from it protected so the events aren't part of every compiler's public interface
+    class ParseEventHandler
+    {
+    public:
+        virtual ~ParseEventHandler()
+        {
+        }
+
+        // The length isn't known until Leave()
+        virtual void Enter(unsigned short /* symbolID */, long /* start */) {}
+        virtual void Leave(unsigned short /* symbolID */, long /* start */, long /* length */) {}
+        // text is the Symbol's ToString(), flattenType is None or Token
+        virtual void Token(unsigned short /* symbolID */, FlattenType /* flattenType */, long /* start */, long /* length */, const std::string & /* text */) {}
+
+        // Sends the events for symbol, which a rule returned, as though it was being flattened into its parent. position is where
+        // the last event ended and is moved past these ones, see Symbol::start() for the Symbols that don't know where they are
+        void Send(Symbol *symbol, long &position);
+        // True if Send() wouldn't send any events for symbol
+        static bool SendsNothing(Symbol *symbol);
+
+    private:
+        void SendTree(Symbol *root, long &position);
+    };
+}
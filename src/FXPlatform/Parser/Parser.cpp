@@ -5,6 +5,135 @@ using namespace FXPlat;
 
 shared_ptr<Symbol> EofSymbol::defaultValue = shared_ptr<Symbol>(new EofSymbol());
 
+static vector<shared_ptr<Symbol>> CreateCharacterSymbols()
+{
+    vector<shared_ptr<Symbol>> symbols;
+    for(int character = 0; character < 256; ++character)
+    {
+        symbols.push_back(shared_ptr<Symbol>(new LexerSymbol((char) character)));
+    }
+
+    return symbols;
+}
+
+vector<shared_ptr<Symbol>> LexerSymbol::characterSymbols = CreateCharacterSymbols();
+const FirstSet FirstSet::unknown;
+
+FirstSet::FirstSet(Outcome outcome, const char *failMessage)
+{
+    for(int character = 0; character < 256; ++character)
+    {
+        m_outcomes[character] = outcome;
+        m_messages[character] = failMessage;
+    }
+}
+
+// OrExpression: the first alternative that doesn't fail decides, if they all fail the last one reported the deepest failure last
+FirstSet FirstSet::Choice(const vector<const FirstSet *> &alternatives, const char *staticErrorMessage)
+{
+    FirstSet first;
+    if(alternatives.size() == 0)
+    {
+        return first;
+    }
+
+    for(int character = 0; character < 256; ++character)
+    {
+        Outcome outcome = Outcome::Fail;
+        const char *message = nullptr;
+        for(vector<const FirstSet *>::const_iterator iter = alternatives.begin(); iter != alternatives.end(); ++iter)
+        {
+            outcome = (*iter)->outcome((char) character);
+            if(outcome != Outcome::Fail)
+            {
+                break;
+            }
+
+            message = (*iter)->message((char) character);
+        }
+
+        first.Set((char) character, outcome, outcome == Outcome::Fail ? CallerMessage(message, staticErrorMessage) : nullptr);
+    }
+
+    return first;
+}
+
+// GroupExpression, ReplaceExpression and PeekExpression do whatever their child does
+FirstSet FirstSet::Group(const FirstSet &child, const char *staticErrorMessage)
+{
+    FirstSet first;
+    for(int character = 0; character < 256; ++character)
+    {
+        Outcome outcome = child.outcome((char) character);
+        first.Set((char) character, outcome, outcome == Outcome::Fail ? CallerMessage(child.message((char) character), staticErrorMessage) : nullptr);
+    }
+
+    return first;
+}
+
+// NotPeekExpression succeeds without consuming anything if its child fails. If the child succeeds without consuming anything the 
+// only failure is reported at the character itself, not after it, so that has to be parsed
+FirstSet FirstSet::NotPeek(const FirstSet &child)
+{
+    FirstSet first;
+    for(int character = 0; character < 256; ++character)
+    {
+        if(child.outcome((char) character) == Outcome::Fail)
+        {
+            first.Set((char) character, Outcome::Empty);
+        }
+    }
+
+    return first;
+}
+
+// AtLeastAndAtMostExpression and the rules based on it: if the child fails the first time, it is up to atLeast. A child that succeeds
+// without consuming anything gets repeated, so that has to be parsed
+FirstSet FirstSet::Repeat(const FirstSet &child, int atLeast, const char *staticErrorMessage)
+{
+    FirstSet first;
+    for(int character = 0; character < 256; ++character)
+    {
+        if(child.outcome((char) character) == Outcome::Fail)
+        {
+            if(atLeast == 0)
+            {
+                first.Set((char) character, Outcome::Empty);
+            }
+            else
+            {
+                first.Set((char) character, Outcome::Fail, CallerMessage(child.message((char) character), staticErrorMessage));
+            }
+        }
+    }
+
+    return first;
+}
+
+// AndExpression: children that succeed without consuming anything leave the character for the next child
+FirstSet FirstSet::Sequence(const vector<const FirstSet *> &children, const char *staticErrorMessage)
+{
+    FirstSet first;
+    for(int character = 0; character < 256; ++character)
+    {
+        Outcome outcome = Outcome::Empty;
+        const char *message = nullptr;
+        for(vector<const FirstSet *>::const_iterator iter = children.begin(); iter != children.end(); ++iter)
+        {
+            outcome = (*iter)->outcome((char) character);
+            if(outcome != Outcome::Empty)
+            {
+                message = (*iter)->message((char) character);
+                break;
+            }
+        }
+
+        first.Set((char) character, outcome, outcome == Outcome::Fail ? CallerMessage(message, staticErrorMessage) : nullptr);
+    }
+
+    return first;
+}
+
 namespace FXPlat
 {
     char AmpersandString[] = "&";
@@ -1,8 +1,15 @@
 #pragma once
 #include "FXPlatform/FailFast.h"
 #include "FXPlatform/NanoTrace.h"
+#include "ParserTrace.h"
+#include "CharClass.h"
+#include "CharRunScanner.h"
+#include "FlattenType.h"
 #include <list>
 #include "LexerReader.h"
+#include "ParseContext.h"
+#include "RuleProfiler.h"
+#include "SymbolArena.h"
 #include <vector>
 #include <algorithm>
 
@@ -17,8 +24,9 @@
  document with a successful rule (or fails).
 
  A rule is any object derived from Symbol that has the following method on it:
-	static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
-that returns a Symbol if success or null if failure.
+	static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
+that returns a Symbol if success or null if failure. (LexerTryParse() adds the TryParse(shared_ptr<Lexer>, ...) that 
+is used to start parsing, see ParseContext.)
     They read characters from the Lexer in a (potentially nested) transaction.
         If they succeed, they "commit" the transaction which means they "consume" the characters, removing them from the string so that other rules can't see them
         If they fail, the transaction rolls back which allows something else to see them
@@ -43,7 +51,6 @@ Each of the rule templates have some standard arguments that can be tweaked when
  */
  namespace FXPlat
 {
-    class EmptyClass;
     class EofSymbol;
     class Lexer;
     class LexerReader;
@@ -93,6 +100,8 @@ Each of the rule templates have some standard arguments that can be tweaked when
     {
     public:
         static bool IsCharacterSymbol(shared_ptr<Symbol> symbol);
+        // True if the Lexer would return a character symbol for character (as opposed to one whose ID is out of the character range)
+        static bool IsCharacterSymbol(char character) { return (unsigned short) character <= 255; }
         static bool AllCharacterSymbols(vector<shared_ptr<Symbol> > symbolVector);
 
         SymbolDef(carriageReturn, '\r');
@@ -117,24 +126,109 @@ Each of the rule templates have some standard arguments that can be tweaked when
         SymbolDef(integerExpression, 272);
         SymbolDef(notUnmatchedBlockExpression, 273);
         SymbolDef(floatExpression, 274);
+        // What rules that succeed return when they don't return a Symbol, see Lexer::matched()
+        SymbolDef(matched, 275);
+        SymbolDef(cutExpression, 276);
     };
 
-    // Allow you to control "flattening" which controls what the tree looks like if the node is successful:
-    //  - Flatten means take this symbol out of the tree and reparent its children to its parent (which is useful for nodes that are there for mechanics, not the meaning of the parse tree)
-    //  - Delete means remove this symbol and all children completely (which you might want to do for a comment)
-    //  - None means leave this node in the tree (for when the node is meaningful like a name of something)
-    enum class FlattenType
+    // Error messages are the static strings given to the rules as template arguments (or the one given to the
+    // first rule, see LexerTryParse()), so they are passed around as pointers and only copied into a string
+    // when the error is read using Lexer::ErrorMessage()
+    #define GetError(myErrorMessage, passedErrorMessage) \
+        ((myErrorMessage)[0] == '\0' ? (passedErrorMessage) : (const char *) (myErrorMessage))
+
+    #define Spaces() \
+        string((size_t) (context.lexer().TransactionDepth() * 3), ' ')
+
+    // Used to trace a character that came from PeekChar() or ReadChar()
+    #define CharacterString(found, character) \
+        ((found) ? string(1, (character)) : string("<EOF>"))
+
+    // Used to trace the text a Symbol returned by TryParseRule() matched. Its ToString() would leave out whatever
+    // was already flattened away (see Symbol::AddSubsymbol())
+    #define ParsedText(symbol) \
+        context.lexer().Text((symbol)->start(), (symbol)->start() + (symbol)->length())
+
+    // Describes what a rule will do when it is tried at a position that isn't the end of the document, based only on the character there.
+    // OrExpression uses it to skip alternatives that are sure to fail without calling them, so each rule figures this out from the 
+    // rules it is made of (see FirstSetOf()).  
+    class FirstSet
     {
-        None,
-        Delete,
-        Flatten
+    public:
+        enum class Outcome : unsigned char
+        {
+            // Have to actually parse the rule to know
+            Parse,
+            // Succeeds without consuming anything 
+            Empty,
+            // Fails, and the deepest failure it reports is right after the character, with message
+            Fail
+        };
+
+        FirstSet(Outcome outcome = Outcome::Parse, const char *failMessage = nullptr);
+        
+        // The message a rule reports when it fails is the innermost static error message, or the one passed into the outermost rule if they are all empty.  
+        // So: message is nullptr if the failing rule uses the message it was passed, and this gives the message the calling rule's FirstSet should have
+        static const char *CallerMessage(const char *message, const char *staticErrorMessage)
+        {
+            return message != nullptr ? message : (staticErrorMessage[0] == '\0' ? nullptr : staticErrorMessage);
+        }
+
+        // A rule that reads one character and succeeds if isMatch(character) or reports failure with staticErrorMessage
+        template<class IsMatchFunction>
+        static FirstSet Character(IsMatchFunction isMatch, const char *staticErrorMessage)
+        {
+            FirstSet first;
+            for(int character = 0; character < 256; ++character)
+            {
+                if(!isMatch((char) character))
+                {
+                    first.Set((char) character, Outcome::Fail, CallerMessage(nullptr, staticErrorMessage));
+                }
+            }
+
+            return first;
+        }
+
+        // Rules that call other rules
+        static FirstSet Choice(const vector<const FirstSet *> &alternatives, const char *staticErrorMessage);
+        static FirstSet Group(const FirstSet &child, const char *staticErrorMessage);
+        static FirstSet NotPeek(const FirstSet &child);
+        static FirstSet Repeat(const FirstSet &child, int atLeast, const char *staticErrorMessage);
+        static FirstSet Sequence(const vector<const FirstSet *> &children, const char *staticErrorMessage);
+
+        const char *message(char character) const { return m_messages[(unsigned char) character]; }
+        Outcome outcome(char character) const { return m_outcomes[(unsigned char) character]; }
+        void Set(char character, Outcome outcome, const char *message = nullptr)
+        {
+            m_outcomes[(unsigned char) character] = outcome;
+            m_messages[(unsigned char) character] = message;
+        }
+
+        // Used by rules that don't know anything about how they start
+        static const FirstSet unknown;
+
+    private:
+        Outcome m_outcomes[256];
+        const char *m_messages[256];
     };
 
-    #define GetError(myErrorMessage, passedErrorMessage) \
-        (string(myErrorMessage) == "" ? passedErrorMessage : myErrorMessage)
+    // Computes RuleType::ComputeFirst() once and returns it after that. A grammar that can call a rule from itself without consuming anything
+    // would recurse forever, so while a rule is being computed it is treated as unknown
+    template<class RuleType>
+    const FirstSet &FirstSetOf()
+    {
+        static thread_local bool computing = false;
+        if(computing)
+        {
+            return FirstSet::unknown;
+        }
 
-    #define Spaces() \
-        string((size_t) (lexer->TransactionDepth() * 3), ' ')
+        computing = true;
+        static const FirstSet first = RuleType::ComputeFirst();
+        computing = false;
+        return first;
+    }
 
 	// This is the base class that is used by all the rules and the primary thing the rules (and thus the Parser) generate
     class Symbol : public enable_shared_from_this<Symbol>
@@ -142,12 +236,16 @@ Each of the rule templates have some standard arguments that can be tweaked when
     public:
         Symbol(unsigned short symbolID) : 
             m_flattenType(FlattenType::None),
+            m_length(0),
+            m_start(-1),
             m_symbolID(symbolID)
         {
         }
 
         Symbol(unsigned short symbolID, FlattenType flattenType) : 
             m_flattenType(flattenType),
+            m_length(0),
+            m_start(-1),
             m_symbolID(symbolID)
         {
         }
@@ -156,10 +254,29 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
         
+        // Children are flattened as they are added instead of in a pass over the whole tree at the end: a Flatten child is
+        // replaced by its children (which were already flattened when they were added to it) and a Delete child is dropped.
+        // Nothing is kept under a Delete Symbol since it will be dropped too
         void AddSubsymbol(shared_ptr<Symbol> symbol)
         {
             FailFastAssert(symbol != nullptr);
-            m_subSymbols.push_back(symbol);
+            if(m_flattenType == FlattenType::Delete)
+            {
+                return;
+            }
+
+            switch(symbol->m_flattenType)
+            {
+            case FlattenType::None:
+            case FlattenType::Token:
+                m_subSymbols.push_back(symbol);
+                break;
+            case FlattenType::Delete:
+                break;
+            case FlattenType::Flatten:
+                m_subSymbols.insert(m_subSymbols.end(), symbol->m_subSymbols.begin(), symbol->m_subSymbols.end());
+                break;
+            }
         }
 
         void AddSubsymbol(vector<shared_ptr<Symbol>>::iterator begin, vector<shared_ptr<Symbol>>::iterator end)
@@ -167,8 +284,7 @@ Each of the rule templates have some standard arguments that can be tweaked when
             for_each(begin, end, [&]
                      (shared_ptr<Symbol> &symbol)
                      {
-                         FailFastAssert(symbol != nullptr);
-                         this->m_subSymbols.push_back(symbol);
+                         this->AddSubsymbol(symbol);
                      });
         }
 
@@ -186,46 +302,30 @@ Each of the rule templates have some standard arguments that can be tweaked when
             return m_subSymbols;
         }
 
-        virtual void FlattenInto(vector<shared_ptr<Symbol> > &symbolVector)
+        // The children are already flattened (see AddSubsymbol()) so this only has to do the same for this Symbol
+        void FlattenInto(vector<shared_ptr<Symbol> > &symbolVector)
         { 
             switch(m_flattenType)
             {
             case FlattenType::None:
-                NoFlatten(symbolVector); 
+            case FlattenType::Token:
+                symbolVector.push_back(shared_from_this());
                 break;
             case FlattenType::Delete:
                 // Don't add this symbol or any children to the tree
                 break;
             case FlattenType::Flatten:
-                FlattenChildren(symbolVector);
+                symbolVector.insert(symbolVector.end(), m_subSymbols.begin(), m_subSymbols.end());
                 break;
             }
         }
 
-        void FlattenChildren(vector<shared_ptr<Symbol> > &symbolVector)
-        {
-            for_each(m_subSymbols.begin(), m_subSymbols.end(),
-                [&] (shared_ptr<Symbol> child)
-            {
-                FailFastAssert(child != nullptr);
-                child->FlattenInto(symbolVector);
-            });
-        }
-
-        void NoFlatten(vector<shared_ptr<Symbol> > &symbolVector)
-        {
-            vector<shared_ptr<Symbol> > newChildren;
-            FlattenChildren(newChildren);
-            m_subSymbols.swap(newChildren);
-            symbolVector.push_back(shared_from_this());
-        }
-
         int HasSubsymbols() { return m_subSymbols.size() > 0; }
         int SubsymbolCount() { return (int) m_subSymbols.size(); }
         bool operator==(const Symbol &other) const { return m_symbolID == other.m_symbolID; }
         bool operator!=(const Symbol &other) const { return !(*this == other); }
 
-        string ToString()
+        virtual string ToString()
         {
             stringstream stream;
             AddToStream(stream);
@@ -234,20 +334,74 @@ Each of the rule templates have some standard arguments that can be tweaked when
 
         unsigned short symbolID() { return m_symbolID; };
         FlattenType flattenType() { return m_flattenType; };
+        // Where the Symbol is in the document, set by TryParseRule() when the rule that created it succeeds. The characters
+        // the Lexer hands out are shared by every document (see LexerSymbol) so they don't know and start() is -1
+        long length() { return m_length; }
+        long start() { return m_start; }
+        void span(long start, long length) { m_start = start; m_length = length; }
+
+        // Terminal rules are the ones that read characters from the Lexer directly instead of calling other rules
+        // They are cheap enough that TryParseRule() never memoizes them
+        static const bool terminalRule = false;
+
+        // Rules that match one character from a CharClass set this and have a static Allowed() that returns the class
+        // so that repeating them can read a whole run of characters at once, see CharacterRun
+        static const bool characterClassRule = false;
+
+        // Only CutExpression sets this, AndExpression checks it to know where its cut is
+        static const bool cutRule = false;
+
+        // Rules that can tell what they will do from the first character override this, see FirstSet
+        static const FirstSet &First() { return FirstSet::unknown; }
 
     protected:
         FlattenType m_flattenType;
+        long m_length;
+        long m_start;
 		// SymbolID needs to be a number that is unique for the entire parser
 		// so that you know what got generated later
         unsigned short m_symbolID;
         vector<shared_ptr<Symbol> > m_subSymbols;
     };
 
+    // All the Symbols the rules create come from here so that they come out of the Lexer's SymbolArena if it has one
+    template<class SymbolType, class... Arguments>
+    shared_ptr<SymbolType> NewSymbol(Lexer &lexer, Arguments&&... arguments)
+    {
+        SymbolArena *arena = lexer.arena();
+        if(arena == nullptr)
+        {
+            return shared_ptr<SymbolType>(new SymbolType(std::forward<Arguments>(arguments)...));
+        }
+        else
+        {
+            return allocate_shared<SymbolType>(SymbolArenaAllocator<SymbolType>(arena), std::forward<Arguments>(arguments)...);
+        }
+    }
+
+    // While validating (see Lexer::validate()) the rules only need to know which rules succeed, so they don't build Symbols. 
+    // Rules create the Symbol they return with RuleSymbol(), which is nullptr while validating, and return Matched() of it
+    // which is never nullptr
+    template<class SymbolType, class... Arguments>
+    shared_ptr<SymbolType> RuleSymbol(ParseContext &context, Arguments&&... arguments)
+    {
+        return context.validate() ? nullptr : NewSymbol<SymbolType>(context.lexer(), std::forward<Arguments>(arguments)...);
+    }
+
+    inline shared_ptr<Symbol> Matched(ParseContext &context, shared_ptr<Symbol> symbol)
+    {
+        return symbol != nullptr ? symbol : context.lexer().matched();
+    }
+
 	// Symbols returned by the Lexer are simple characters (except for EOF) and will
-	// be of this class
+	// be of this class.
+	// The Lexer doesn't allocate these, it hands out the preallocated instance for the character from
+	// ForCharacter() which is shared by all Lexers and threads.  Thus the same instance can appear many
+	// times in a tree and must never be changed (i.e. never add children to one)
     class LexerSymbol : public Symbol
     {
     public:
+        static const bool terminalRule = true;
         LexerSymbol(char character) : Symbol(character, FlattenType::None)
         {
         }
@@ -257,18 +411,154 @@ Each of the rule templates have some standard arguments that can be tweaked when
             stream << (char) m_symbolID;
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static const shared_ptr<Symbol> &ForCharacter(char character)
         {
-            lexer->ReportFailure(GetError(DefaultErrorMessage, errorMessage));
+            return characterSymbols[(unsigned char) character];
+        }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
+        {
+            context.ReportFailure(GetError(DefaultErrorMessage, errorMessage));
             return nullptr;
         }
+
+    private:
+        static vector<shared_ptr<Symbol>> characterSymbols;
+    };
+
+	// What rules with FlattenType::Token return instead of a tree with a Symbol for each character: a leaf that records where
+	// its text is in the document. The text isn't copied if the Lexer was reading from a buffer, the token points into it 
+	// and keeps the buffer's owner alive. For a stream it has to be copied
+    class TokenSymbol : public Symbol
+    {
+    public:
+        TokenSymbol(unsigned short symbolID, long start, const char *text, long length, shared_ptr<void> textOwner) :
+            Symbol(symbolID, FlattenType::Token),
+            m_text(text),
+            m_textLength(length),
+            m_textOwner(textOwner)
+        {
+            span(start, length);
+        }
+
+        // The token for the characters between start and end that lexer just read
+        static shared_ptr<Symbol> ForText(unsigned short symbolID, Lexer &lexer, long start, long end)
+        {
+            if(lexer.buffer() != nullptr)
+            {
+                return NewSymbol<TokenSymbol>(lexer, symbolID, start, lexer.buffer() + start, end - start, lexer.bufferOwner());
+            }
+            else
+            {
+                shared_ptr<string> text = shared_ptr<string>(new string(lexer.Text(start, end)));
+                return NewSymbol<TokenSymbol>(lexer, symbolID, start, text->c_str(), (long) text->size(), text);
+            }
+        }
+
+        virtual void AddToStream(stringstream &stream) 
+        {
+            stream.write(m_text, m_textLength);
+        }
+
+        const char *text() { return m_text; }
+        long textLength() { return m_textLength; }
+        virtual string ToString() { return string(m_text, (size_t) m_textLength); }
+
+    private:
+        const char *m_text;
+        long m_textLength;
+        shared_ptr<void> m_textOwner;
+    };
+
+    // The address of id is unique to SymbolType and identifies it in a MemoTable
+    template<class SymbolType>
+    class RuleIdentity
+    {
+    public:
+        static const char id;
     };
 
+    template<class SymbolType>
+    const char RuleIdentity<SymbolType>::id = 0;
+
+    // Parses SymbolType at the current position using table to remember the result. If the rule was already parsed here
+    // the result (and the failures it reported) are replayed from the table instead.
+    // TableType is MemoTable or WindowedMemoTable
+    template<class SymbolType, class TableType>
+    shared_ptr<Symbol> TryParseMemoized(ParseContext &context, TableType &table, const char *errorMessage)
+    {
+        const void *rule = &RuleIdentity<SymbolType>::id;
+        long position = context.lexer().consumedCharacters();
+        MemoEntry *entry = table.Find(rule, position);
+        if(entry != nullptr && entry->errorMessage == errorMessage)
+        {
+            ParserTraceString3("{0}{1}({2}) - TryParseMemoized replayed", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                Spaces(), errorMessage, entry->result == nullptr ? "FAIL" : "Succ");
+            context.lexer().ReplayMemo(*entry);
+            return entry->result;
+        }
+
+        long savedDeepestFailure;
+        const char *savedErrorMessage;
+        context.lexer().BeginMemo(savedDeepestFailure, savedErrorMessage);
+        shared_ptr<Symbol> result = SymbolType::TryParse(context, errorMessage);
+        MemoEntry &newEntry = table.Add(rule, position);
+        newEntry.errorMessage = errorMessage;
+        context.lexer().EndMemo(newEntry, result, savedDeepestFailure, savedErrorMessage);
+        return result;
+    }
+
+    template<class SymbolType>
+    shared_ptr<Symbol> TryParseRuleMemoized(ParseContext &context, const char *errorMessage)
+    {
+        if(SymbolType::terminalRule || !context.memoize())
+        {
+            return SymbolType::TryParse(context, errorMessage);
+        }
+        else
+        {
+            return TryParseMemoized<SymbolType, MemoTable>(context, context.memo(), errorMessage);
+        }
+    }
+
+    // Rules call the rules they are made of using this instead of calling SymbolType::TryParse() directly
+    // so that the results are memoized when the Lexer has memoization turned on (see Lexer::memoize())
+    // and recorded when it has a RuleProfiler
+    template<class SymbolType>
+    shared_ptr<Symbol> TryParseRule(ParseContext &context, const char *errorMessage)
+    {
+        context.StartRule();
+        long position = context.lexer().consumedCharacters();
+        RuleProfiler *profiler = context.profiler();
+        shared_ptr<Symbol> result;
+        if(profiler == nullptr)
+        {
+            result = TryParseRuleMemoized<SymbolType>(context, errorMessage);
+        }
+        else
+        {
+            profiler->Enter(&RuleIdentity<SymbolType>::id, typeid(SymbolType));
+            result = TryParseRuleMemoized<SymbolType>(context, errorMessage);
+            profiler->Exit(result, context.lexer().consumedCharacters() - position);
+        }
+
+        if(result != nullptr)
+        {
+            result->span(position, context.lexer().consumedCharacters() - position);
+        }
+
+        return result;
+    }
+
 	// Matches a single character. The SymbolID used is the ascii value of the character.
     template<char *character, FlattenType flatten = FlattenType::Delete, char *staticErrorMessage = DefaultErrorMessage>
     class CharacterSymbol : public Symbol
     {
     public:
+        static const bool terminalRule = true;
+        static const bool characterClassRule = true;
         typedef CharacterSymbol<character, flatten, staticErrorMessage> ThisType;
         CharacterSymbol() : Symbol(*character, flatten)
         {
@@ -278,29 +568,45 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
+        static const CharClass &Allowed()
+        {
+            static const CharClass allowed = SymbolID::IsCharacterSymbol(*character) ? CharClass::Range(*character, *character) : CharClass();
+            return allowed;
+        }
+
+        static FirstSet ComputeFirst()
+        {
+            return FirstSet::Character([](char streamCharacter) { return SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == *character; }, staticErrorMessage);
+        }
+
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
         virtual void AddToStream(stringstream &stream) 
         {
             stream << (char) m_symbolID;
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
+            LexerReader reader(context.lexer());
             reader.Begin();
-            shared_ptr<Symbol> streamSymbol = reader.Read();
+            char streamCharacter;
+            bool found = reader.ReadChar(streamCharacter);
          
-            if(SymbolID::IsCharacterSymbol(streamSymbol) && streamSymbol->symbolID() == *character)
+            if(found && SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == *character)
             {
-                TraceString3("{0}{1}(Succ) - CharacterSymbol::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString());
+                ParserTraceString3("{0}{1}(Succ) - CharacterSymbol::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter));
                 reader.Commit();
-                return shared_ptr<ThisType>(new ThisType());
+                return Matched(context, RuleSymbol<ThisType>(context));
             }
             else
             {
-                TraceString4("{0}{1}(FAIL) - CharacterSymbol::Parse found '{2}', wanted '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), character);
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                ParserTraceString4("{0}{1}(FAIL) - CharacterSymbol::Parse found '{2}', wanted '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter), character);
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -310,27 +616,39 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class EofSymbol : public Symbol
     {
     public:
+        static const bool terminalRule = true;
         EofSymbol() : Symbol(SymbolID::eof, FlattenType::Delete)
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        // Always fails if there is a character, with the message it was passed
+        static const FirstSet &First() 
+        { 
+            static const FirstSet first(FirstSet::Outcome::Fail); 
+            return first; 
+        }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
+            LexerReader reader(context.lexer());
             reader.Begin();
-            shared_ptr<Symbol> streamSymbol = reader.Read();
-            if(streamSymbol->symbolID() == SymbolID::eof)
+            char streamCharacter;
+            bool found = reader.ReadChar(streamCharacter);
+            if(!found)
             {
-                TraceString2("{0}{1}(Succ) - EofSymbol::Parse", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(Succ) - EofSymbol::Parse", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), errorMessage);
                 reader.Commit();
-                return streamSymbol;
+                // A new one instead of defaultValue since its span gets set
+                return Matched(context, RuleSymbol<EofSymbol>(context));
             }
             else
             {
-                TraceString3("{0}{1}(FAIL) - EofSymbol::Parse, found {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), errorMessage, streamSymbol->ToString());
-                lexer->ReportFailure(errorMessage);
+                ParserTraceString3("{0}{1}(FAIL) - EofSymbol::Parse, found {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), errorMessage, CharacterString(found, streamCharacter));
+                context.ReportFailure(errorMessage);
                 return nullptr;
             }
         }
@@ -353,25 +671,56 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        // Everything that isn't in disallowedCharacters or '\0', as long as it is a character symbol (see SymbolID::IsCharacterSymbol())
+        static const CharClass &Allowed()
+        {
+            static const CharClass allowed = ComputeAllowed();
+            return allowed;
+        }
+
+        static CharClass ComputeAllowed()
+        {
+            CharClass allowed = ~(CharClass(disallowedCharacters) | CharClass::Range('\0', '\0'));
+            for(int character = 0; character < 256; ++character)
+            {
+                if(!SymbolID::IsCharacterSymbol((char) character))
+                {
+                    allowed.Remove((char) character);
+                }
+            }
+
+            return allowed;
+        }
+
+        static FirstSet ComputeFirst()
+        {
+            return FirstSet::Character([](char streamCharacter) { return Allowed().Contains(streamCharacter); }, staticErrorMessage);
+        }
+
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
+            LexerReader reader(context.lexer());
             reader.Begin();
-            shared_ptr<Symbol> streamSymbol = reader.Read();
+            char streamCharacter;
+            bool found = reader.ReadChar(streamCharacter);
         
-            if(SymbolID::IsCharacterSymbol(streamSymbol) && strchr(disallowedCharacters, streamSymbol->symbolID()) == nullptr)
+            if(found && Allowed().Contains(streamCharacter))
             {
-                TraceString4("{0}{1}(Succ) - CharacterSetExceptSymbol::Parse found '{2}' expected not any of '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic,
-                    Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), disallowedCharacters);
+                ParserTraceString4("{0}{1}(Succ) - CharacterSetExceptSymbol::Parse found '{2}' expected not any of '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic,
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter), disallowedCharacters);
                 reader.Commit();
-                return shared_ptr<ThisType>(new ThisType((char) streamSymbol->symbolID()));
+                return Matched(context, RuleSymbol<ThisType>(context, streamCharacter));
             }
             else
             {
                 // not found
-                TraceString4("{0}{1}(FAIL) - CharacterSetExceptSymbol::Parse found '{2}' expected not any of'{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic,
-                    Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), disallowedCharacters);
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                ParserTraceString4("{0}{1}(FAIL) - CharacterSetExceptSymbol::Parse found '{2}' expected not any of'{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic,
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter), disallowedCharacters);
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -387,26 +736,43 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        // '\0' is included because sets have always been checked with strchr(), which finds the null at the end of the string
+        static const CharClass &Allowed()
+        {
+            static const CharClass allowed = CharClass(allowedCharacters) | CharClass::Range('\0', '\0');
+            return allowed;
+        }
+
+        static FirstSet ComputeFirst()
         {
-            LexerReader reader(lexer);
+            return FirstSet::Character([](char streamCharacter) { return Allowed().Contains(streamCharacter); }, staticErrorMessage);
+        }
+
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
+        {
+            LexerReader reader(context.lexer());
             reader.Begin();
-            shared_ptr<Symbol> streamSymbol = reader.Read();
+            char streamCharacter;
+            bool found = reader.ReadChar(streamCharacter);
         
-            if((streamSymbol->symbolID() == SymbolID::eof) || strchr(allowedCharacters, streamSymbol->symbolID()) == nullptr)
+            if(!found || !Allowed().Contains(streamCharacter))
             {
                 // not found
-                TraceString4("{0}{1}(FAIL) - CharacterSetSymbol::Parse found '{2}', wanted one of '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), allowedCharacters);
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                ParserTraceString4("{0}{1}(FAIL) - CharacterSetSymbol::Parse found '{2}', wanted one of '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter), allowedCharacters);
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
             else
             {
-                TraceString4("{0}{1}(Succ) - CharacterSetSymbol::Parse found '{2}', wanted one of '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), allowedCharacters);
+                ParserTraceString4("{0}{1}(Succ) - CharacterSetSymbol::Parse found '{2}', wanted one of '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter), allowedCharacters);
                 reader.Commit();
-                return shared_ptr<ThisType>(new ThisType((char) streamSymbol->symbolID()));
+                return Matched(context, RuleSymbol<ThisType>(context, streamCharacter));
             }
         }
     };
@@ -419,51 +785,164 @@ Each of the rule templates have some standard arguments that can be tweaked when
     typedef CharacterSetSymbol<HexNumbers> HexNumberSymbol;
 	typedef CharacterSetSymbol<WhitespaceChars> WhitespaceCharSymbol;
 
+	// Character classes for CharacterClassSymbol. Each is a type with a static Value() that returns a CharClass so that they
+	// can be combined right in the grammar, for example the letters that aren't hex digits:
+	//		CharacterClassSymbol<CharDifference<Characters<CharsAndNumbers>, Characters<HexNumbers>>>
+    template<char *characters>
+    class Characters
+    {
+    public:
+        static const CharClass &Value()
+        {
+            static const CharClass value(characters);
+            return value;
+        }
+    };
+
+    template<class Class1, class Class2>
+    class CharUnion
+    {
+    public:
+        static const CharClass &Value()
+        {
+            static const CharClass value = Class1::Value() | Class2::Value();
+            return value;
+        }
+    };
+
+	// The characters in Class1 that aren't in Class2
+    template<class Class1, class Class2>
+    class CharDifference
+    {
+    public:
+        static const CharClass &Value()
+        {
+            static const CharClass value = Class1::Value() - Class2::Value();
+            return value;
+        }
+    };
+
+    template<class Class>
+    class CharNegation
+    {
+    public:
+        static const CharClass &Value()
+        {
+            static const CharClass value = ~Class::Value();
+            return value;
+        }
+    };
+
+	// Matches any single character in CharClassType::Value(). The SymbolID used is the ascii value of the character.
+    template<class CharClassType, FlattenType flatten = FlattenType::None, char *staticErrorMessage = DefaultErrorMessage>
+    class CharacterClassSymbol : public CharacterSymbol<NullString, flatten, staticErrorMessage>
+    {
+    public:
+        typedef CharacterClassSymbol<CharClassType, flatten, staticErrorMessage> ThisType;
+        CharacterClassSymbol(char character) : CharacterSymbol<NullString, flatten, staticErrorMessage>(character)
+        {
+        }
+
+        static const CharClass &Allowed() { return CharClassType::Value(); }
+
+        static FirstSet ComputeFirst()
+        {
+            return FirstSet::Character([](char streamCharacter) { return CharClassType::Value().Contains(streamCharacter); }, staticErrorMessage);
+        }
+
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
+        {
+            LexerReader reader(context.lexer());
+            reader.Begin();
+            char streamCharacter;
+            bool found = reader.ReadChar(streamCharacter);
+        
+            if(found && CharClassType::Value().Contains(streamCharacter))
+            {
+                ParserTraceString3("{0}{1}(Succ) - CharacterClassSymbol::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter));
+                reader.Commit();
+                return Matched(context, RuleSymbol<ThisType>(context, streamCharacter));
+            }
+            else
+            {
+                ParserTraceString3("{0}{1}(FAIL) - CharacterClassSymbol::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), CharacterString(found, streamCharacter));
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
+                return nullptr;
+            }
+        }
+    };
+
 	// Matches a specific string of characters.
     template<char *literalString, FlattenType flatten = FlattenType::None, unsigned short ID = SymbolID::literalExpression, char *staticErrorMessage = DefaultErrorMessage>
     class LiteralExpression : public Symbol
     {
     public:
+        static const bool terminalRule = true;
         typedef LiteralExpression<literalString, flatten, ID, staticErrorMessage> ThisType;
         LiteralExpression() : Symbol(ID, flatten)
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst()
         {
-            LexerReader reader(lexer);
+            if(literalString[0] == '\0')
+            {
+                return FirstSet::unknown;
+            }
+            else
+            {
+                return FirstSet::Character([](char streamCharacter) { return SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == literalString[0]; }, staticErrorMessage);
+            }
+        }
+
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
+        {
+            LexerReader reader(context.lexer());
             reader.Begin();
-            shared_ptr<Symbol> streamSymbol;
-            shared_ptr<ThisType> literalSymbol = shared_ptr<ThisType>(new ThisType());
+            long literalLength = (long) strlen(literalString);
+            bool foundEof;
+            char streamCharacter;
+            long matched = reader.ReadSpan(literalString, literalLength, foundEof, streamCharacter);
 
-            int position = 0;
-            while(literalString[position] != '\0' && reader.Read(streamSymbol) != SymbolID::eof)
+            if(matched == literalLength)
             {
-                if(SymbolID::IsCharacterSymbol(streamSymbol) && streamSymbol->symbolID() == literalString[position])
+                ParserTraceString3("{0}{1}(Succ) - LiteralExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), literalString);
+                reader.Commit();
+                if(flatten == FlattenType::Token)
                 {
-                    literalSymbol->AddSubsymbol(streamSymbol);
+                    // The text is always literalString
+                    return Matched(context, RuleSymbol<TokenSymbol>(context, ID, context.lexer().consumedCharacters() - literalLength, literalString, literalLength, nullptr));
                 }
-                else
+
+                shared_ptr<ThisType> literalSymbol = RuleSymbol<ThisType>(context);
+                for(long position = 0; literalSymbol != nullptr && position < literalLength; ++position)
                 {
-                    TraceString4("{0}{1}(FAIL) - LiteralExpression::Parse found '{2}', wanted '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                        Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), literalString[position]);
-                    lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
-                    return nullptr;
+                    literalSymbol->AddSubsymbol(LexerSymbol::ForCharacter(literalString[position]));
                 }
 
-                position++;
+                return Matched(context, literalSymbol);
             }
-
-            if(position == strlen(literalString))
+            else if(!foundEof)
             {
-                TraceString3("{0}{1}(Succ) - LiteralExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), literalString);
-                reader.Commit();
-                return literalSymbol;
+                ParserTraceString4("{0}{1}(FAIL) - LiteralExpression::Parse found '{2}', wanted '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), streamCharacter, literalString[matched]);
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
+                return nullptr;
             }
             else
             {
-                TraceString3("{0}{1}(FAIL) - LiteralExpression::Parse wanted '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString3("{0}{1}(FAIL) - LiteralExpression::Parse wanted '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage), literalString);
                 return nullptr;
             }
@@ -481,58 +960,64 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class NotUnmatchedBlockExpression : public Symbol
     {
     public:
+        static const bool terminalRule = true;
         typedef NotUnmatchedBlockExpression<startBlockChar, endBlockChar, flatten, ID, staticErrorMessage> ThisType;
         NotUnmatchedBlockExpression() : Symbol(ID, flatten)
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
             // start with blockLevel = 1
             // Loop through grabbing characters adding 1 if we see startBlockChar, subtracting 1 if we see endBlockChar
             // When blockLevel == 0 we are done, rollback so the ending character is still in the stream and exit
-            LexerReader reader(lexer);
-            shared_ptr<Symbol> streamSymbol;
-            shared_ptr<ThisType> symbol = shared_ptr<ThisType>(new ThisType());
+            LexerReader reader(context.lexer());
+            char streamCharacter;
+            shared_ptr<ThisType> symbol = RuleSymbol<ThisType>(context);
             int blockLevel = 1;
 
             reader.Begin();
-            while(reader.Peek(streamSymbol) != SymbolID::eof)
+            while(reader.PeekChar(streamCharacter))
             {
-                if(SymbolID::IsCharacterSymbol(streamSymbol) && streamSymbol->symbolID() == startBlockChar[0])
+                if(SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == startBlockChar[0])
                 {
                     blockLevel++;
                 }
-                else if(SymbolID::IsCharacterSymbol(streamSymbol) && streamSymbol->symbolID() == endBlockChar[0])
+                else if(SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == endBlockChar[0])
                 {
                     blockLevel--;
                     if(blockLevel == 0)
                     {
                         // Success! Don't consume the final symbol and return
-                        TraceString3("{0}{1}(Succ) - NotUnmatchedBlockExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                        ParserTraceString3("{0}{1}(Succ) - NotUnmatchedBlockExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                             Spaces(), GetError(staticErrorMessage, errorMessage), endBlockChar);
                         reader.Commit();
-                        return symbol;
+                        return Matched(context, symbol);
                     }
                 }
 
-                reader.Read();
-                symbol->AddSubsymbol(streamSymbol);
+                reader.ReadChar(streamCharacter);
+                if(symbol != nullptr)
+                {
+                    symbol->AddSubsymbol(LexerSymbol::ForCharacter(streamCharacter));
+                }
             }
 
             // We're at EOF.  If all the blocks have been closed but one, this is a success
             if(blockLevel == 1)
             {
-                TraceString3("{0}{1}(Succ) - NotUnmatchedBlockExpression::Parse found '<EOF>'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString3("{0}{1}(Succ) - NotUnmatchedBlockExpression::Parse found '<EOF>'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage), endBlockChar);
                 reader.Commit();
-                return symbol;
+                return Matched(context, symbol);
             }
             else
             {
-                TraceString5("{0}{1}(FAIL) - NotUnmatchedBlockExpression::Parse still {4} deep within nested '{2}{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString5("{0}{1}(FAIL) - NotUnmatchedBlockExpression::Parse still {4} deep within nested '{2}{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage), startBlockChar, endBlockChar, blockLevel);
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -543,47 +1028,67 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class NotLiteralExpression : public Symbol
     {
     public:
+        static const bool terminalRule = true;
         typedef NotLiteralExpression<literalString, flatten, ID, staticErrorMessage> ThisType;
         NotLiteralExpression() : Symbol(ID, flatten)
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
-            shared_ptr<Symbol> streamSymbol;
-            shared_ptr<ThisType> symbol = shared_ptr<ThisType>(new ThisType());
-            vector<shared_ptr<Symbol>> partialLiteral;
+            LexerReader reader(context.lexer());
+            char streamCharacter;
+            // Tokens don't need the children, see Result()
+            shared_ptr<ThisType> symbol = flatten == FlattenType::Token ? nullptr : RuleSymbol<ThisType>(context);
+            long start = context.lexer().consumedCharacters();
 
             // Each stream of characters is a different transaction  
             // We commit the transaction and start a new one if 
             // we see a new beginning of the literal
             reader.Begin();
-            while(reader.Peek(streamSymbol) != SymbolID::eof)
+            while(true)
             {
+                // Everything up to the next character that could start the literal can be consumed in one go
+                const char *run;
+                long runLength = reader.ReadRun(RunScanner(), LONG_MAX, run);
+                for(long index = 0; symbol != nullptr && index < runLength; ++index)
+                {
+                    symbol->AddSubsymbol(LexerSymbol::ForCharacter(run[index]));
+                }
+
+                if(!reader.PeekChar(streamCharacter))
+                {
+                    break;
+                }
+
                 // If we see the beginning of the literal, commit the characters we've read so far and
                 // try to read the literal
-                if(SymbolID::IsCharacterSymbol(streamSymbol) && streamSymbol->symbolID() == literalString[0])
+                if(SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == literalString[0])
                 {
                     reader.Commit();
                     reader.Begin();
                     int position = 0;
-                    vector<shared_ptr<Symbol>> partialLiteral;
-                    while(literalString[position] != '\0' && reader.Peek(streamSymbol) != SymbolID::eof)
+                    bool foundEof = false;
+                    while(literalString[position] != '\0')
                     {
-                        if(streamSymbol->symbolID() == literalString[position])
+                        if(!reader.PeekChar(streamCharacter))
+                        {
+                            foundEof = true;
+                            break;
+                        }
+                        else if(SymbolID::IsCharacterSymbol(streamCharacter) && streamCharacter == literalString[position])
                         {
-                            // Consume the symbol
-                            reader.Read();
-                            partialLiteral.push_back(streamSymbol);
+                            // Consume the character
+                            reader.ReadChar(streamCharacter);
                             position++;
                         }
                         else
                         {
-                            // Not a complete literal, commit and push symbols into outer symbol
+                            // Not a complete literal, commit and push the partial literal into outer symbol
                             reader.Commit();
-                            symbol->AddSubsymbol(partialLiteral.begin(), partialLiteral.end());
-                            partialLiteral.clear();
+                            AddLiteralCharacters(symbol, position);
                             reader.Begin();
                             break;
                         }
@@ -592,35 +1097,113 @@ Each of the rule templates have some standard arguments that can be tweaked when
                     if(literalString[position] == '\0')
                     {
                         // We found the entire literal, rollback so it is still there and exit
-                        TraceString3("{0}{1}(Succ) - NotLiteralExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                        ParserTraceString3("{0}{1}(Succ) - NotLiteralExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                             Spaces(), GetError(staticErrorMessage, errorMessage), literalString);
                         reader.Abort();
-                        return symbol;
+                        return Result(symbol, context, start);
                     }
-                    else if(streamSymbol->symbolID() == SymbolID::eof)
+                    else if(foundEof)
                     {
                         // We are at EOF
                         // There was a partial symbol at the end, push into outer sumbol
-                        TraceString2("{0}{1}(Succ) - NotLiteralExpression::Parse found <EOF>", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                        ParserTraceString2("{0}{1}(Succ) - NotLiteralExpression::Parse found <EOF>", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                             Spaces(), GetError(staticErrorMessage, errorMessage));
                         reader.Commit();
-                        symbol->AddSubsymbol(partialLiteral.begin(), partialLiteral.end());
-                        partialLiteral.clear();
-                        return symbol;
+                        AddLiteralCharacters(symbol, position);
+                        return Result(symbol, context, start);
                     }
                 }
                 else
                 {
                     // Not part of our literal, consume and continue
-                    reader.Read();
-                    symbol->AddSubsymbol(streamSymbol);
+                    reader.ReadChar(streamCharacter);
+                    if(symbol != nullptr)
+                    {
+                        symbol->AddSubsymbol(LexerSymbol::ForCharacter(streamCharacter));
+                    }
                 }
             }
 
-            TraceString2("{0}{1}(Succ) - NotLiteralExpression::Parse found <EOF>", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+            ParserTraceString2("{0}{1}(Succ) - NotLiteralExpression::Parse found <EOF>", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                 Spaces(), GetError(staticErrorMessage, errorMessage));
             reader.Commit();
-            return symbol;
+            return Result(symbol, context, start);
+        }
+
+    private:
+        // Tokens don't get the children, just the text from start to where the lexer is now
+        static shared_ptr<Symbol> Result(shared_ptr<ThisType> symbol, ParseContext &context, long start)
+        {
+            if(flatten == FlattenType::Token && !context.validate())
+            {
+                return TokenSymbol::ForText(ID, context.lexer(), start, context.lexer().consumedCharacters());
+            }
+
+            return Matched(context, symbol);
+        }
+
+        static const CharRunScanner &RunScanner()
+        {
+            static const CharRunScanner scanner(SymbolID::IsCharacterSymbol(literalString[0]) ? ~CharClass::Range(literalString[0], literalString[0]) : ~CharClass());
+            return scanner;
+        }
+
+        // Adds the first count characters of the literal as children
+        static void AddLiteralCharacters(shared_ptr<ThisType> symbol, int count)
+        {
+            for(int position = 0; symbol != nullptr && position < count; ++position)
+            {
+                symbol->AddSubsymbol(LexerSymbol::ForCharacter(literalString[position]));
+            }
+        }
+    };
+
+	// Used by AtLeastAndAtMostExpression to add a whole run of characters that match SymbolType at once when it
+	// matches a single character (see Symbol::characterClassRule).  The children are the same as parsing them one at a time
+	// expression is nullptr if the characters are being read for a token and don't need Symbols, or are being sent as events instead
+	// if streaming (see ParseContext::streaming()). Returns how many were read
+    template<class SymbolType, bool characterClassRule = SymbolType::characterClassRule>
+    class CharacterRun
+    {
+    public:
+        static long Read(ParseContext & /* context */, LexerReader & /* reader */, Symbol * /* expression */, bool /* streaming */, long /* maxLength */)
+        {
+            return 0;
+        }
+    };
+
+    template<class SymbolType>
+    class CharacterRun<SymbolType, true>
+    {
+    public:
+        static long Read(ParseContext &context, LexerReader &reader, Symbol *expression, bool streaming, long maxLength)
+        {
+            static const CharRunScanner scanner(SymbolType::Allowed());
+            const char *run;
+            long runLength = reader.ReadRun(scanner, maxLength, run);
+            long start = context.lexer().consumedCharacters() - runLength;
+            RuleProfiler *profiler = context.profiler();
+            if(profiler != nullptr && runLength > 0)
+            {
+                // TryParseRule() would have returned the Lexer's matched Symbol when validating
+                profiler->MatchedRun(&RuleIdentity<SymbolType>::id, typeid(SymbolType), runLength, context.validate() ? SymbolID::matched : (unsigned short) run[0]);
+            }
+
+            for(long index = 0; (expression != nullptr || streaming) && index < runLength; ++index)
+            {
+                shared_ptr<SymbolType> symbol = NewSymbol<SymbolType>(context.lexer(), run[index]);
+                symbol->span(start + index, 1);
+                if(streaming)
+                {
+                    context.Send(symbol.get());
+                }
+                else
+                {
+                    expression->AddSubsymbol(symbol);
+                }
+            }
+
+            return runLength;
         }
     };
 
@@ -637,43 +1220,97 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst() { return FirstSet::Repeat(SymbolType::First(), AtLeast, staticErrorMessage); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
-            shared_ptr<ThisType> expression = shared_ptr<ThisType>(new ThisType());
-            shared_ptr<Symbol> streamSymbol;
+            // When streaming each repetition is sent as soon as it is parsed. The repetitions themselves aren't streaming since
+            // any of them could fail without this failing. A token is sent as one Symbol by whatever called it
+            bool streaming = context.streaming() && (flatten == FlattenType::None || flatten == FlattenType::Flatten);
+            LexerReader reader(context.lexer());
+            // Tokens only need the text so the children aren't kept
+            shared_ptr<ThisType> expression = flatten == FlattenType::Token || streaming ? nullptr : RuleSymbol<ThisType>(context);
+            long start = context.lexer().consumedCharacters();
+            if(streaming && flatten == FlattenType::None)
+            {
+                context.SendEnter(ID, start);
+            }
 
             reader.Begin();
+            // If SymbolType is a single character, read as many as possible at once. The loop then fails on the 
+            // character that ended the run (and reports it) just like it would have
+            // Deleted characters are never kept so they don't need Symbols
+            long count = CharacterRun<SymbolType>::Read(context, reader, flatten == FlattenType::Delete ? nullptr : expression.get(), streaming, AtMost);
             shared_ptr<Symbol> newSymbol;
             do
             {
-                newSymbol = SymbolType::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+                // The repetitions can cut when this is streaming since nothing backtracks over the ones already sent
+                if(streaming)
+                {
+                    context.AllowCutInNextRule();
+                }
+
+                newSymbol = TryParseRule<SymbolType>(context, GetError(staticErrorMessage, errorMessage));
+                if(newSymbol == nullptr && streaming && context.cutFailed())
+                {
+                    ParserTraceString4("{0}{1}(FAIL) - {2}to{3}Expression::Parse repetition failed after its cut", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                        Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost);
+                    context.ReportFailure(GetError(staticErrorMessage, errorMessage));
+                    return nullptr;
+                }
+
                 if(newSymbol != nullptr)
                 {
-                    expression->AddSubsymbol(newSymbol);
+                    count++;
+                    if(streaming)
+                    {
+                        context.Send(newSymbol.get());
+                    }
+                    else if(expression != nullptr)
+                    {
+                        expression->AddSubsymbol(newSymbol);
+                    }
                 }
 
-                if(expression->SubsymbolCount() > AtMost)
+                if(count > AtMost)
                 {
-                    TraceString5("{0}{1}(FAIL) - {2}to{3}Expression::Parse count= {4}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                        Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost, expression->SubsymbolCount());
-                    lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                    ParserTraceString5("{0}{1}(FAIL) - {2}to{3}Expression::Parse count= {4}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                        Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost, count);
+                    context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                     return nullptr;
                 }
             } while(newSymbol != nullptr);
 
-            if(expression->SubsymbolCount() >= AtLeast)
+            if(count >= AtLeast)
             {
-                TraceString5("{0}{1}(Succ) - {2}to{3}Expression::Parse count= {4}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost, expression->SubsymbolCount());
+                ParserTraceString5("{0}{1}(Succ) - {2}to{3}Expression::Parse count= {4}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost, count);
                 reader.Commit();
-                return expression;
+                if(flatten == FlattenType::Token && !context.validate())
+                {
+                    return TokenSymbol::ForText(ID, context.lexer(), start, context.lexer().consumedCharacters());
+                }
+
+                if(streaming)
+                {
+                    if(flatten == FlattenType::None)
+                    {
+                        context.SendLeave(ID, start, context.lexer().consumedCharacters() - start);
+                    }
+
+                    return context.lexer().matched();
+                }
+
+                return Matched(context, expression);
             }
             else
             {
-                TraceString5("{0}{1}(FAIL) - {2}to{3}Expression::Parse count= {4}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost, expression->SubsymbolCount());
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                ParserTraceString5("{0}{1}(FAIL) - {2}to{3}Expression::Parse count= {4}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), AtLeast, AtMost, count);
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -684,9 +1321,10 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class NOrMoreExpression : public AtLeastAndAtMostExpression<SymbolType, N, INT_MAX, flatten, ID, staticErrorMessage>
     {
     public:
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            return AtLeastAndAtMostExpression<SymbolType, N, INT_MAX, flatten, ID, staticErrorMessage>::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            return AtLeastAndAtMostExpression<SymbolType, N, INT_MAX, flatten, ID, staticErrorMessage>::TryParse(context, GetError(staticErrorMessage, errorMessage));
         }
     };
 
@@ -695,9 +1333,10 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class OneOrMoreExpression : public AtLeastAndAtMostExpression<SymbolType, 1, INT_MAX, flatten, ID, staticErrorMessage>
     {
     public:
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            return AtLeastAndAtMostExpression<SymbolType, 1, INT_MAX, flatten, ID, staticErrorMessage>::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            return AtLeastAndAtMostExpression<SymbolType, 1, INT_MAX, flatten, ID, staticErrorMessage>::TryParse(context, GetError(staticErrorMessage, errorMessage));
         }
     };
 
@@ -706,9 +1345,10 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class ZeroOrMoreExpression : public AtLeastAndAtMostExpression<SymbolType, 0, INT_MAX, flatten, ID, staticErrorMessage>
     {
     public:
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            return AtLeastAndAtMostExpression<SymbolType, 0, INT_MAX, flatten, ID, staticErrorMessage>::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            return AtLeastAndAtMostExpression<SymbolType, 0, INT_MAX, flatten, ID, staticErrorMessage>::TryParse(context, GetError(staticErrorMessage, errorMessage));
         }
     };
 
@@ -724,26 +1364,30 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
+        static FirstSet ComputeFirst() { return FirstSet::Group(SymbolType::First(), staticErrorMessage); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
         virtual void AddToStream(stringstream &stream)
         {
             stream << replacementString;
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            shared_ptr<Symbol> newSymbol = SymbolType::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            shared_ptr<Symbol> newSymbol = TryParseRule<SymbolType>(context, GetError(staticErrorMessage, errorMessage));
             if(newSymbol != nullptr)
             {
-                TraceString2("{0}{1}(Succ) - ReplaceNodeExpression subexpression succeeded", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(Succ) - ReplaceNodeExpression subexpression succeeded", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage));
-                shared_ptr<ThisType> expression = shared_ptr<ThisType>(new ThisType());
-                return expression;
+                return Matched(context, RuleSymbol<ThisType>(context));
             }
             else
             {
-                TraceString2("{0}{1}(FAIL) - ReplaceNodeExpression::subexpression failed", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(FAIL) - ReplaceNodeExpression::subexpression failed", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage));
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -761,22 +1405,31 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst() { return FirstSet::Group(SymbolType::First(), staticErrorMessage); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            shared_ptr<Symbol> newSymbol = SymbolType::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            shared_ptr<Symbol> newSymbol = TryParseRule<SymbolType>(context, GetError(staticErrorMessage, errorMessage));
             if(newSymbol != nullptr)
             {
-                TraceString2("{0}{1}(Succ) - GroupExpression subexpression succeeded", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(Succ) - GroupExpression subexpression succeeded", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage));
-                shared_ptr<ThisType> expression = shared_ptr<ThisType>(new ThisType());
-                expression->AddSubsymbol(newSymbol);
-                return expression;
+                shared_ptr<ThisType> expression = RuleSymbol<ThisType>(context);
+                if(expression != nullptr)
+                {
+                    expression->AddSubsymbol(newSymbol);
+                }
+
+                return Matched(context, expression);
             }
             else
             {
-                TraceString2("{0}{1}(FAIL) - GroupExpression::subexpression failed", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(FAIL) - GroupExpression::subexpression failed", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage));
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -787,128 +1440,218 @@ Each of the rule templates have some standard arguments that can be tweaked when
     class OptionalExpression : public AtLeastAndAtMostExpression<SymbolType, 0, 1, flatten, ID, staticErrorMessage>
     {
     public:
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        LexerTryParse()
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            return AtLeastAndAtMostExpression<SymbolType, 0, 1, flatten, ID, staticErrorMessage>::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            return AtLeastAndAtMostExpression<SymbolType, 0, 1, flatten, ID, staticErrorMessage>::TryParse(context, GetError(staticErrorMessage, errorMessage));
         }
     };
 
-	// Used as a bogus default argument for the Args class below
-	class EmptyClass
-	{
-	public:
-		static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string& errorMessage)
-		{
-			StaticFailFastAssert(false);
-			return nullptr;
-		}
-	};
-
-	// Args is a Template hack that allows for adding a variable number of arguments that are symbols.
+	// Returns exactly what SymbolType does, but remembers the result at each position so that it isn't parsed again
+	// when the parser backtracks and tries it at the same position.  Wrap the few rules that get reparsed a lot
+	// (like the attributes of a start tag that gets tried as several kinds of element) to get most of the benefit
+	// of Lexer::memoize() with a fixed amount of memory, see WindowedMemoTable
+    template<class SymbolType>
+    class Memoized : public Symbol
+    {
+    public:
+        static const FirstSet &First() { return SymbolType::First(); }
+        LexerTryParse()
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
+        {
+            if(context.memoize())
+            {
+                // Everything is already being memoized, including this rule
+                return SymbolType::TryParse(context, errorMessage);
+            }
+            else
+            {
+                return TryParseMemoized<SymbolType, WindowedMemoTable>(context, context.ruleMemo(), errorMessage);
+            }
+        }
+    };
+
+	// Args is a list of any number of rules.
 	// It is used by rules like And and Or that accept many rules. They assume the class you pass in is of
-	// type "Args"
-    template<class Symbol1 = EmptyClass, class Symbol2 = EmptyClass, class Symbol3 = EmptyClass, class Symbol4 = EmptyClass, class Symbol5 = EmptyClass,
-        class Symbol6 = EmptyClass, class Symbol7 = EmptyClass, class Symbol8 = EmptyClass, class Symbol9 = EmptyClass, class Symbol10 = EmptyClass,
-        class Symbol11 = EmptyClass, class Symbol12 = EmptyClass, class Symbol13 = EmptyClass, class Symbol14 = EmptyClass, class Symbol15 = EmptyClass,
-        class Symbol16 = EmptyClass, class Symbol17 = EmptyClass, class Symbol18 = EmptyClass, class Symbol19 = EmptyClass, class Symbol20 = EmptyClass>
-    class Args
+	// type "Args".  Each rule in the list is handled by its own specialization of Args so that And and Or
+	// loop over them at compile time: the calls to each rule are inlined one after another, not chosen at runtime
+    template<class... Symbols>
+    class Args;
+
+    // What an AndExpression keeps while Args::TryParseAll() parses its symbols
+    class AndState
     {
     public:
-        static int Count()
-        {
-            int count = 
-                (!std::is_empty<Symbol1>::value ? 1 : 0) +
-                (!std::is_empty<Symbol2>::value ? 1 : 0) +
-                (!std::is_empty<Symbol3>::value ? 1 : 0) +
-                (!std::is_empty<Symbol4>::value ? 1 : 0) +
-                (!std::is_empty<Symbol5>::value ? 1 : 0) +
-                (!std::is_empty<Symbol6>::value ? 1 : 0) +
-                (!std::is_empty<Symbol7>::value ? 1 : 0) +
-                (!std::is_empty<Symbol8>::value ? 1 : 0) +
-                (!std::is_empty<Symbol9>::value ? 1 : 0) +
-                (!std::is_empty<Symbol10>::value ? 1 : 0) +
-                (!std::is_empty<Symbol11>::value ? 1 : 0) +
-                (!std::is_empty<Symbol12>::value ? 1 : 0) +
-                (!std::is_empty<Symbol13>::value ? 1 : 0) +
-                (!std::is_empty<Symbol14>::value ? 1 : 0) +
-                (!std::is_empty<Symbol15>::value ? 1 : 0) +
-                (!std::is_empty<Symbol16>::value ? 1 : 0) +
-                (!std::is_empty<Symbol17>::value ? 1 : 0) +
-                (!std::is_empty<Symbol18>::value ? 1 : 0) +
-                (!std::is_empty<Symbol19>::value ? 1 : 0) +
-                (!std::is_empty<Symbol20>::value ? 1 : 0);
-
-            return count;
-        }
-
-        static shared_ptr<Symbol> TryParse(int symbolIndex, shared_ptr<Lexer> lexer, const string &errorMessage)
-        {
-            switch(symbolIndex)
+        AndState(shared_ptr<Symbol> expression, bool streaming, bool cutAllowed, unsigned short symbolID, FlattenType flattenType, long start) :
+            cut(false),
+            cutAllowed(cutAllowed),
+            expression(expression),
+            flattenType(flattenType),
+            start(start),
+            streaming(streaming),
+            symbolID(symbolID)
+        {
+        }
+
+        // Called at the CutExpression when cutAllowed: sends what has been parsed so far and streams the rest. The parser won't
+        // go back before start after this so the Memoized<> rules from back there aren't needed either
+        void Cut(ParseContext &context)
+        {
+            context.ruleMemo().EvictBefore(start);
+            if(flattenType != FlattenType::Flatten)
             {
-            case 0:
-                StaticFailFastAssert(!std::is_empty<Symbol1>::value);
-                return Symbol1::TryParse(lexer, errorMessage);
-            case 1:
-                StaticFailFastAssert(!std::is_empty<Symbol2>::value);
-                return Symbol2::TryParse(lexer, errorMessage);
-            case 2:
-                StaticFailFastAssert(!std::is_empty<Symbol3>::value);
-                return Symbol3::TryParse(lexer, errorMessage);
-            case 3:
-                StaticFailFastAssert(!std::is_empty<Symbol4>::value);
-                return Symbol4::TryParse(lexer, errorMessage);
-            case 4:
-                StaticFailFastAssert(!std::is_empty<Symbol5>::value);
-                return Symbol5::TryParse(lexer, errorMessage);
-            case 5:
-                StaticFailFastAssert(!std::is_empty<Symbol6>::value);
-                return Symbol6::TryParse(lexer, errorMessage);
-            case 6:
-                StaticFailFastAssert(!std::is_empty<Symbol7>::value);
-                return Symbol7::TryParse(lexer, errorMessage);
-            case 7:
-                StaticFailFastAssert(!std::is_empty<Symbol8>::value);
-                return Symbol8::TryParse(lexer, errorMessage);
-            case 8:
-                StaticFailFastAssert(!std::is_empty<Symbol9>::value);
-                return Symbol9::TryParse(lexer, errorMessage);
-            case 9:
-                StaticFailFastAssert(!std::is_empty<Symbol10>::value);
-                return Symbol10::TryParse(lexer, errorMessage);
-            case 10:
-                StaticFailFastAssert(!std::is_empty<Symbol11>::value);
-                return Symbol11::TryParse(lexer, errorMessage);
-            case 11:
-                StaticFailFastAssert(!std::is_empty<Symbol12>::value);
-                return Symbol12::TryParse(lexer, errorMessage);
-            case 12:
-                StaticFailFastAssert(!std::is_empty<Symbol13>::value);
-                return Symbol13::TryParse(lexer, errorMessage);
-            case 13:
-                StaticFailFastAssert(!std::is_empty<Symbol14>::value);
-                return Symbol14::TryParse(lexer, errorMessage);
-            case 14:
-                StaticFailFastAssert(!std::is_empty<Symbol15>::value);
-                return Symbol15::TryParse(lexer, errorMessage);
-            case 15:
-                StaticFailFastAssert(!std::is_empty<Symbol16>::value);
-                return Symbol16::TryParse(lexer, errorMessage);
-            case 16:
-                StaticFailFastAssert(!std::is_empty<Symbol17>::value);
-                return Symbol17::TryParse(lexer, errorMessage);
-            case 17:
-                StaticFailFastAssert(!std::is_empty<Symbol18>::value);
-                return Symbol18::TryParse(lexer, errorMessage);
-            case 18:
-                StaticFailFastAssert(!std::is_empty<Symbol19>::value);
-                return Symbol19::TryParse(lexer, errorMessage);
-            case 19:
-                StaticFailFastAssert(!std::is_empty<Symbol20>::value);
-                return Symbol20::TryParse(lexer, errorMessage);
-            default:
-                StaticFailFastAssert(false);
-                return nullptr;
+                context.SendEnter(symbolID, start);
+            }
+
+            if(expression != nullptr)
+            {
+                for(const shared_ptr<Symbol> &child : expression->children())
+                {
+                    context.Send(child.get());
+                }
             }
+
+            expression = nullptr;
+            streaming = true;
+            cut = true;
+        }
+
+        bool cut;
+        bool cutAllowed;
+        // nullptr when streaming or validating
+        shared_ptr<Symbol> expression;
+        FlattenType flattenType;
+        long start;
+        bool streaming;
+        unsigned short symbolID;
+    };
+
+    template<>
+    class Args<>
+    {
+    public:
+        static int Count() { return 0; }
+        static void AddFirsts(vector<const FirstSet *> & /* firsts */) {}
+        static vector<const FirstSet *> Firsts() { return vector<const FirstSet *>(); }
+
+        static shared_ptr<Symbol> TryParse(int /* symbolIndex */, ParseContext & /* context */, const char * /* errorMessage */)
+        {
+            StaticFailFastAssert(false);
+            return nullptr;
+        }
+
+        static int TryParseAll(ParseContext & /* context */, const char * /* errorMessage */, AndState & /* state */, int /* symbolIndex */ = 0)
+        {
+            return -1;
+        }
+
+        static shared_ptr<Symbol> TryParseFirst(ParseContext & /* context */, const char * /* errorMessage */, const FirstSet *const * /* firsts */, bool /* foundCharacter */,
+            char /* nextCharacter */, bool /* allowCut */, int & /* symbolIndex */)
+        {
+            return nullptr;
+        }
+    };
+
+    template<class Symbol1, class... Rest>
+    class Args<Symbol1, Rest...>
+    {
+    public:
+        static int Count() { return 1 + (int) sizeof...(Rest); }
+
+        static void AddFirsts(vector<const FirstSet *> &firsts)
+        {
+            firsts.push_back(&Symbol1::First());
+            Args<Rest...>::AddFirsts(firsts);
+        }
+
+        // The FirstSet of each symbol, in order
+        static vector<const FirstSet *> Firsts()
+        {
+            vector<const FirstSet *> firsts;
+            AddFirsts(firsts);
+            return firsts;
+        }
+
+        static shared_ptr<Symbol> TryParse(int symbolIndex, ParseContext &context, const char *errorMessage)
+        {
+            if(symbolIndex == 0)
+            {
+                return TryParseRule<Symbol1>(context, errorMessage);
+            }
+            else
+            {
+                return Args<Rest...>::TryParse(symbolIndex - 1, context, errorMessage);
+            }
+        }
+
+        // Used by AndExpression: parses each symbol in order and adds it to state.expression (unless it is nullptr). Returns the index of 
+        // the first one that fails, or -1 if they all succeed. If state.streaming (see ParseContext::streaming()) each symbol is streaming 
+        // too, and whatever it returns is sent instead of added. A CutExpression starts streaming there if state.cutAllowed
+        static int TryParseAll(ParseContext &context, const char *errorMessage, AndState &state, int symbolIndex = 0)
+        {
+            // The cut matches nothing so it isn't parsed
+            if(Symbol1::cutRule)
+            {
+                if(state.cutAllowed && !state.streaming)
+                {
+                    state.Cut(context);
+                }
+
+                return Args<Rest...>::TryParseAll(context, errorMessage, state, symbolIndex + 1);
+            }
+
+            if(state.streaming)
+            {
+                context.StreamNextRule();
+            }
+
+            shared_ptr<Symbol> streamSymbol = TryParseRule<Symbol1>(context, errorMessage);
+            if(streamSymbol == nullptr)
+            {
+                return symbolIndex;
+            }
+
+            if(state.streaming)
+            {
+                context.Send(streamSymbol.get());
+            }
+            else if(state.expression != nullptr)
+            {
+                state.expression->AddSubsymbol(streamSymbol);
+            }
+
+            return Args<Rest...>::TryParseAll(context, errorMessage, state, symbolIndex + 1);
+        }
+
+        // Used by OrExpression: returns the first symbol that succeeds (and sets symbolIndex to which one it was), or nullptr if none do.
+        // firsts are the FirstSets of the symbols, see OrExpression::TryParse(). If allowCut each symbol is allowed to cut (see 
+        // ParseContext::cutAllowed()) until one fails past its cut
+        static shared_ptr<Symbol> TryParseFirst(ParseContext &context, const char *errorMessage, const FirstSet *const *firsts, bool foundCharacter, char nextCharacter, 
+            bool allowCut, int &symbolIndex)
+        {
+            if(foundCharacter && (*firsts)->outcome(nextCharacter) == FirstSet::Outcome::Fail)
+            {
+                const char *message = (*firsts)->message(nextCharacter);
+                ParserTraceString4("{0}{1}(FAIL) - OrExpression::Parse symbol #{2} skipped, can't start with '{3}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), errorMessage, symbolIndex, nextCharacter);
+                context.ReportFailureAt(context.lexer().consumedCharacters() + 1, message != nullptr ? message : errorMessage);
+            }
+            else
+            {
+                if(allowCut)
+                {
+                    context.AllowCutInNextRule();
+                }
+
+                shared_ptr<Symbol> streamSymbol = TryParseRule<Symbol1>(context, errorMessage);
+                if(streamSymbol != nullptr)
+                {
+                    return streamSymbol;
+                }
+            }
+
+            symbolIndex++;
+            return Args<Rest...>::TryParseFirst(context, errorMessage, firsts + 1, foundCharacter, nextCharacter, allowCut && !context.cutFailed(), symbolIndex);
         }
     };
 
@@ -923,30 +1666,45 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst() { return FirstSet::Choice(Args::Firsts(), staticErrorMessage); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
-            shared_ptr<ThisType> expression = shared_ptr<ThisType>(new ThisType());
+            LexerReader reader(context.lexer());
+            shared_ptr<ThisType> expression = RuleSymbol<ThisType>(context);
+            static const vector<const FirstSet *> alternatives = Args::Firsts();
 
             // Loop through the symbols and succeed the first time one works
+            // Symbols that are sure to fail on the next character aren't called, but report the same failure they would have
             reader.Begin();
-            int argsCount = Args::Count();
-            for(int symbolIndex = 0; symbolIndex < argsCount; ++symbolIndex)
+            char nextCharacter;
+            bool foundCharacter = reader.PeekChar(nextCharacter);
+            int symbolIndex = 0;
+            // Only one alternative can succeed in the end so they can cut if this is streaming or can cut. Their events are
+            // sent directly so this can't have its own. If one fails past its cut nothing else can match, the rest are still tried
+            // so that they report the same failures but this fails
+            bool allowCut = (context.streaming() || context.cutAllowed()) && flatten == FlattenType::Flatten;
+            shared_ptr<Symbol> streamSymbol = Args::TryParseFirst(context, GetError(staticErrorMessage, errorMessage), alternatives.data(), foundCharacter, nextCharacter, 
+                allowCut, symbolIndex);
+            if(streamSymbol != nullptr && !(allowCut && context.cutFailed()))
             {
-                shared_ptr<Symbol> streamSymbol = Args::TryParse(symbolIndex, lexer, GetError(staticErrorMessage, errorMessage));
-                if(streamSymbol != nullptr)
+                ParserTraceString4("{0}{1}(Succ) - OrExpression::Parse symbol #{3} found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), ParsedText(streamSymbol), symbolIndex);
+                if(expression != nullptr)
                 {
-                    TraceString4("{0}{1}(Succ) - OrExpression::Parse symbol #{3} found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                        Spaces(), GetError(staticErrorMessage, errorMessage), streamSymbol->ToString(), symbolIndex);
                     expression->AddSubsymbol(streamSymbol);
-                    reader.Commit();
-                    return expression;
                 }
+
+                reader.Commit();
+                return Matched(context, expression);
             }
 
-            TraceString2("{0}{1}(FAIL) - OrExpression::Parse", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+            ParserTraceString2("{0}{1}(FAIL) - OrExpression::Parse", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                 Spaces(), GetError(staticErrorMessage, errorMessage));
-            lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+            context.ReportFailure(GetError(staticErrorMessage, errorMessage));
             return nullptr;
         }
     };
@@ -963,33 +1721,80 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst() { return FirstSet::Sequence(Args::Firsts(), staticErrorMessage); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
-            shared_ptr<ThisType> expression = shared_ptr<ThisType>(new ThisType());
+            // If any of the symbols fail this does, so they can send their events as they go when this is streaming, or from its
+            // CutExpression on if it is allowed to cut. Nothing in a Delete rule is sent and a token is sent as one Symbol
+            bool streaming = context.streaming() && flatten != FlattenType::Delete;
+            bool cutAllowed = context.cutAllowed() && (flatten == FlattenType::None || flatten == FlattenType::Flatten);
+            LexerReader reader(context.lexer());
+            long start = context.lexer().consumedCharacters();
+            AndState state(streaming ? nullptr : RuleSymbol<ThisType>(context), streaming, cutAllowed, ID, flatten, start);
+            if(streaming && flatten != FlattenType::Flatten)
+            {
+                context.SendEnter(ID, start);
+            }
 
             reader.Begin();
-            int argsCount = Args::Count();
-            for(int symbolIndex = 0; symbolIndex < argsCount; ++symbolIndex)
+            int failedIndex = Args::TryParseAll(context, GetError(staticErrorMessage, errorMessage), state);
+            if(failedIndex != -1)
             {
-                shared_ptr<Symbol> streamSymbol = Args::TryParse(symbolIndex, lexer, GetError(staticErrorMessage, errorMessage));
-                if(streamSymbol != nullptr)
+                ParserTraceString3("{0}{1}(FAIL) - AndExpression::Parse symbol #{2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), failedIndex);
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
+                if(state.cut)
                 {
-                    expression->AddSubsymbol(streamSymbol);
+                    context.CutFailed();
                 }
-                else
+
+                return nullptr;
+            }
+
+            ParserTraceString3("{0}{1}(Succ) - AndExpression::Parse found {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                Spaces(), GetError(staticErrorMessage, errorMessage), context.lexer().Text(start, context.lexer().consumedCharacters()));
+            reader.Commit();
+            if(state.streaming)
+            {
+                if(flatten != FlattenType::Flatten)
                 {
-                    TraceString3("{0}{1}(FAIL) - AndExpression::Parse symbol #{2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                        Spaces(), GetError(staticErrorMessage, errorMessage), symbolIndex);
-                    lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
-                    return nullptr;
+                    context.SendLeave(ID, start, context.lexer().consumedCharacters() - start);
                 }
+
+                return context.lexer().matched();
             }
 
-            TraceString3("{0}{1}(Succ) - AndExpression::Parse found {2}", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                Spaces(), GetError(staticErrorMessage, errorMessage), expression->ToString());
-            reader.Commit();
-            return expression;
+            return Matched(context, state.expression);
+        }
+    };
+
+	// Put in an AndExpression after the symbols that decide nothing else can match where it is. It always matches nothing, but from
+	// there the AndExpression can send its events as it parses (see ParseContext::cutAllowed()) instead of building all its Symbols
+	// first, so documents are only built as deep as they nest. Nothing checks that nothing else could match: if the AndExpression
+	// fails after the cut the whole parse fails when sending events, so only use it where the grammar says so
+    class CutExpression : public Symbol
+    {
+    public:
+        CutExpression() : Symbol(SymbolID::cutExpression, FlattenType::Delete)
+        {
+        }
+
+        static const bool terminalRule = true;
+        static const bool cutRule = true;
+
+        static FirstSet ComputeFirst() { return FirstSet(FirstSet::Outcome::Empty); }
+        static const FirstSet &First() { return FirstSetOf<CutExpression>(); }
+
+        LexerTryParse()
+
+        // AndExpression doesn't call it, anywhere else it does nothing
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char * /* errorMessage */)
+        {
+            return Matched(context, RuleSymbol<CutExpression>(context));
         }
     };
 
@@ -1017,27 +1822,32 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst() { return FirstSet::NotPeek(SymbolType::First()); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
+            LexerReader reader(context.lexer());
             shared_ptr<Symbol> streamSymbol;
 
             reader.Begin();
-            shared_ptr<Symbol> newSymbol = SymbolType::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            shared_ptr<Symbol> newSymbol = TryParseRule<SymbolType>(context, GetError(staticErrorMessage, errorMessage));
             if(newSymbol != nullptr)
             {
-                TraceString3("{0}{1}(FAIL) - NotPeekExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), newSymbol->ToString());
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                ParserTraceString3("{0}{1}(FAIL) - NotPeekExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), ParsedText(newSymbol));
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
             else
             {
                 // Even though this was successful, this is only peeking, so abort anything that happened but succeed
                 reader.Abort();
-                TraceString2("{0}{1}(Succ) - NotPeekExpression::Parse ", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(Succ) - NotPeekExpression::Parse ", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage));
-                return shared_ptr<ThisType>(new ThisType());
+                return Matched(context, RuleSymbol<ThisType>(context));
             }
         }
     };
@@ -1054,26 +1864,31 @@ Each of the rule templates have some standard arguments that can be tweaked when
         {
         }
 
-        static shared_ptr<Symbol> TryParse(shared_ptr<Lexer> lexer, const string &errorMessage)
+        static FirstSet ComputeFirst() { return FirstSet::Group(SymbolType::First(), staticErrorMessage); }
+        static const FirstSet &First() { return FirstSetOf<ThisType>(); }
+
+        LexerTryParse()
+
+        static shared_ptr<Symbol> TryParse(ParseContext &context, const char *errorMessage)
         {
-            LexerReader reader(lexer);
+            LexerReader reader(context.lexer());
             shared_ptr<Symbol> streamSymbol;
 
             reader.Begin();
-            shared_ptr<Symbol> newSymbol = SymbolType::TryParse(lexer, GetError(staticErrorMessage, errorMessage));
+            shared_ptr<Symbol> newSymbol = TryParseRule<SymbolType>(context, GetError(staticErrorMessage, errorMessage));
             if(newSymbol != nullptr)
             {
                 // Even though this was successful, this is only peeking, so abort anything that happened but succeed
                 reader.Abort();
-                TraceString3("{0}{1}(Succ) - PeekExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
-                    Spaces(), GetError(staticErrorMessage, errorMessage), newSymbol->ToString());
-                return shared_ptr<ThisType>(new ThisType());
+                ParserTraceString3("{0}{1}(Succ) - PeekExpression::Parse found '{2}'", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                    Spaces(), GetError(staticErrorMessage, errorMessage), ParsedText(newSymbol));
+                return Matched(context, RuleSymbol<ThisType>(context));
             }
             else
             {
-                TraceString2("{0}{1}(FAIL) - PeekExpression::Parse", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
+                ParserTraceString2("{0}{1}(FAIL) - PeekExpression::Parse", SystemTraceType::Parsing, TraceDetail::Diagnostic, 
                     Spaces(), GetError(staticErrorMessage, errorMessage));
-                lexer->ReportFailure(GetError(staticErrorMessage, errorMessage));
+                context.ReportFailure(GetError(staticErrorMessage, errorMessage));
                 return nullptr;
             }
         }
@@ -1,4 +1,5 @@
 #pragma once
+#include "FlatAst.h"
 #include "Parser.h"
 
 namespace FXPlat
@@ -137,11 +138,16 @@ namespace FXPlat
         }
 
         static string PrintSymbol(shared_ptr<Symbol> symbol, int level)
+        {
+            return PrintNode(symbol->symbolID(), symbol->flattenType(), symbol->ToString(), level);
+        }
+
+        static string PrintNode(unsigned short symbolID, FlattenType flattenType, const string &text, int level)
         {
             stringstream stream;
        
-            stream << string((size_t) (level * 3), ' ') << symbol->symbolID();
-            switch(symbol->flattenType())
+            stream << string((size_t) (level * 3), ' ') << symbolID;
+            switch(flattenType)
             {
             case FlattenType::None:
                 stream << " (None)";
@@ -152,9 +158,12 @@ namespace FXPlat
             case FlattenType::Delete:
                 stream << " (Delete)";
                 break;
+            case FlattenType::Token:
+                stream << " (Token)";
+                break;
             }
 
-            stream << ": " << symbol->ToString() << "\r\n";
+            stream << ": " << text << "\r\n";
 
             return stream.str();
         }
@@ -184,6 +193,35 @@ namespace FXPlat
             return stream.str();
         }
 
+		// Same output as PrintTree() of the Symbols the FlatAst was built from
+        static string PrintTree(const FlatAst &ast)
+        {
+            stringstream stream;
+            // How many children of each node above this one are still left to print
+            vector<int> remaining;
+            for(int index = 0; index < ast.size(); ++index)
+            {
+                FlatAstCursor node(&ast, index);
+                stream << PrintNode(node.symbolID(), node.flattenType(), node.ToString(), (int) remaining.size() + 1);
+                if(remaining.size() > 0)
+                {
+                    --remaining.back();
+                }
+
+                if(node.childCount() > 0)
+                {
+                    remaining.push_back(node.childCount());
+                }
+
+                while(remaining.size() > 0 && remaining.back() == 0)
+                {
+                    remaining.pop_back();
+                }
+            }
+
+            return stream.str();
+        }
+
         static int MaxDepth(const vector<shared_ptr<Symbol>> &symbols)
         {
             int maxDepth = 0;
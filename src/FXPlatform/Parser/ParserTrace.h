@@ -0,0 +1,33 @@
+#pragma once
+#include "FXPlatform/NanoTrace.h"
+
+// The rules in Parser.h and the Lexer trace every step they take. Even when the trace filter is off, each trace
+// is a check of NanoTrace::Global() plus the code that formats its arguments, and that is in every rule instantiated.
+// These are used for those traces instead of TraceStringN() so they can be compiled out: configure with
+// -DPARSER_TRACE=OFF (which defines PARSER_TRACE_DISABLED) and they generate no code.
+// Otherwise they are the same as TraceStringN()
+#ifdef PARSER_TRACE_DISABLED
+// The values are still named, in sizeof() so they aren't evaluated, so a parameter or local that is only
+// traced doesn't become unused
+#define ParserTraceString1(string, traceType, traceDetail, value1) \
+    do { (void) sizeof(value1); } while(0)
+#define ParserTraceString2(string, traceType, traceDetail, value1, value2) \
+    do { (void) sizeof(value1); (void) sizeof(value2); } while(0)
+#define ParserTraceString3(string, traceType, traceDetail, value1, value2, value3) \
+    do { (void) sizeof(value1); (void) sizeof(value2); (void) sizeof(value3); } while(0)
+#define ParserTraceString4(string, traceType, traceDetail, value1, value2, value3, value4) \
+    do { (void) sizeof(value1); (void) sizeof(value2); (void) sizeof(value3); (void) sizeof(value4); } while(0)
+#define ParserTraceString5(string, traceType, traceDetail, value1, value2, value3, value4, value5) \
+    do { (void) sizeof(value1); (void) sizeof(value2); (void) sizeof(value3); (void) sizeof(value4); (void) sizeof(value5); } while(0)
+#else
+#define ParserTraceString1(string, traceType, traceDetail, value1) \
+    TraceString1(string, traceType, traceDetail, value1)
+#define ParserTraceString2(string, traceType, traceDetail, value1, value2) \
+    TraceString2(string, traceType, traceDetail, value1, value2)
+#define ParserTraceString3(string, traceType, traceDetail, value1, value2, value3) \
+    TraceString3(string, traceType, traceDetail, value1, value2, value3)
+#define ParserTraceString4(string, traceType, traceDetail, value1, value2, value3, value4) \
+    TraceString4(string, traceType, traceDetail, value1, value2, value3, value4)
+#define ParserTraceString5(string, traceType, traceDetail, value1, value2, value3, value4, value5) \
+    TraceString5(string, traceType, traceDetail, value1, value2, value3, value4, value5)
+#endif
@@ -0,0 +1,149 @@
+#include "RuleProfiler.h"
+#include "Parser.h"
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+using namespace FXPlat;
+using namespace std;
+
+string RuleProfile::name() const
+{
+    return type == nullptr ? string() : RuleProfiler::RuleName(*type);
+}
+
+void RuleProfiler::Clear()
+{
+    m_rules.clear();
+    m_stack.clear();
+}
+
+void RuleProfiler::Exit(const shared_ptr<Symbol> &result, long consumed)
+{
+    Frame frame = m_stack.back();
+    m_stack.pop_back();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - frame.start).count();
+
+    RuleProfile &profile = *frame.profile;
+    ++profile.attempts;
+    profile.inclusiveTime += elapsed;
+    profile.exclusiveTime += elapsed - frame.childTime;
+    if(result != nullptr)
+    {
+        ++profile.successes;
+        profile.consumed += consumed;
+        if(!profile.hasSymbolID)
+        {
+            profile.hasSymbolID = true;
+            profile.symbolID = result->symbolID();
+        }
+    }
+    else
+    {
+        ++profile.failures;
+    }
+
+    if(m_stack.size() > 0)
+    {
+        m_stack.back().childTime += elapsed;
+    }
+}
+
+void RuleProfiler::MatchedRun(const void *rule, const type_info &type, long count, unsigned short symbolID)
+{
+    RuleProfile &profile = m_rules[rule];
+    profile.type = &type;
+    profile.attempts += count;
+    profile.successes += count;
+    profile.consumed += count;
+    if(!profile.hasSymbolID)
+    {
+        profile.hasSymbolID = true;
+        profile.symbolID = symbolID;
+    }
+}
+
+vector<RuleProfile> RuleProfiler::Profiles()
+{
+    vector<RuleProfile> profiles;
+    for(auto &item : m_rules)
+    {
+        profiles.push_back(item.second);
+    }
+
+    sort(profiles.begin(), profiles.end(), [](const RuleProfile &left, const RuleProfile &right) { return left.exclusiveTime > right.exclusiveTime; });
+    return profiles;
+}
+
+string RuleProfiler::Report(int maxRules)
+{
+    vector<RuleProfile> profiles = Profiles();
+    stringstream stream;
+    stream << "Rules by exclusive time (" << profiles.size() << " rules, times in ms):\r\n";
+    stream << setw(10) << "Exclusive" << setw(10) << "Inclusive" << setw(11) << "Attempts" << setw(11) << "Succeeded" << setw(11) << "Failed"
+        << setw(11) << "Consumed" << setw(11) << "GaveBack" << setw(6) << "ID" << "  Rule\r\n";
+    int count = 0;
+    for(const RuleProfile &profile : profiles)
+    {
+        if(count++ == maxRules)
+        {
+            break;
+        }
+
+        stream << fixed << setprecision(2) << setw(10) << profile.exclusiveTime * 1000 << setw(10) << profile.inclusiveTime * 1000
+            << setw(11) << profile.attempts << setw(11) << profile.successes << setw(11) << profile.failures
+            << setw(11) << profile.consumed << setw(11) << profile.gaveBack << setw(6) << (profile.hasSymbolID ? lexical_cast<string>(profile.symbolID) : string("?"))
+            << "  " << profile.name() << "\r\n";
+    }
+
+    return stream.str();
+}
+
+string RuleProfiler::RuleName(const type_info &type)
+{
+    string name;
+#if defined(__GNUG__)
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    name = (status == 0 && demangled != nullptr) ? string(demangled) : string(type.name());
+    free(demangled);
+#else
+    name = type.name();
+    ReplaceAll(name, "class ", "");
+    ReplaceAll(name, "struct ", "");
+#endif
+
+    // The rule templates are all in FXPlat and the grammars in their own namespace, both just make the names longer
+    string shortName;
+    size_t position = 0;
+    while(position < name.size())
+    {
+        if(isalpha((unsigned char) name[position]) || name[position] == '_')
+        {
+            size_t end = position;
+            while(end < name.size() && (isalnum((unsigned char) name[end]) || name[end] == '_'))
+            {
+                ++end;
+            }
+
+            if(name.compare(end, 2, "::") == 0)
+            {
+                position = end + 2;
+                continue;
+            }
+
+            shortName.append(name, position, end - position);
+            position = end;
+        }
+        else
+        {
+            shortName += name[position++];
+        }
+    }
+
+    return shortName;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace FXPlat
+{
+    class Symbol;
+
+    // What one rule (i.e. one instantiation of a rule template) did during the parses a RuleProfiler recorded
+    class RuleProfile
+    {
+    public:
+        RuleProfile() :
+            attempts(0),
+            consumed(0),
+            exclusiveTime(0),
+            failures(0),
+            gaveBack(0),
+            hasSymbolID(false),
+            inclusiveTime(0),
+            successes(0),
+            symbolID(0),
+            type(nullptr)
+        {
+        }
+
+        // The readable name of the rule's type, see RuleProfiler::RuleName()
+        std::string name() const;
+
+        int64_t attempts;
+        // Characters consumed by the times the rule succeeded
+        int64_t consumed;
+        // Seconds spent in the rule not counting the rules it called
+        double exclusiveTime;
+        int64_t failures;
+        // Characters the rule read and then gave back when it aborted a transaction, i.e. what will get read again
+        int64_t gaveBack;
+        // The SymbolID is taken from the first Symbol the rule returns so it isn't known if the rule never succeeded
+        bool hasSymbolID;
+        // Seconds spent in the rule including the rules it called. A rule that calls itself counts the inner time twice
+        double inclusiveTime;
+        int64_t successes;
+        unsigned short symbolID;
+        const std::type_info *type;
+    };
+
+    // Records how much work each rule does so grammars can be tuned: set one on the Lexer (or the Compiler) and each rule parsed
+    // using TryParseRule() (in Parser.h) is counted. Rules that fail after reading a lot show up as characters given back,
+    // which is the cost of backtracking. Costs nothing when it isn't set but profiling makes parsing a few times slower
+    class RuleProfiler
+    {
+    public:
+        // Called by TryParseRule() before and after a rule is parsed, rule identifies the rule (see RuleIdentity in Parser.h)
+        void Enter(const void *rule, const std::type_info &type)
+        {
+            Frame frame;
+            frame.profile = &m_rules[rule];
+            frame.profile->type = &type;
+            frame.childTime = 0;
+            frame.start = std::chrono::steady_clock::now();
+            m_stack.push_back(frame);
+        }
+
+        void Exit(const std::shared_ptr<Symbol> &result, long consumed);
+        // Called instead of Enter() and Exit() when a rule that matches a single character matches a whole run of count characters
+        // without going through TryParseRule() (see CharacterRun in Parser.h). Counts as count successes of one character each, 
+        // the same as parsing them one at a time would. symbolID is the ID of the first one
+        void MatchedRun(const void *rule, const std::type_info &type, long count, unsigned short symbolID);
+
+        // Called by the Lexer when a transaction is aborted, counts for the rule being parsed
+        void GaveBack(long characters)
+        {
+            if(m_stack.size() > 0)
+            {
+                m_stack.back().profile->gaveBack += characters;
+            }
+        }
+
+        void Clear();
+        // Sorted by exclusive time, most first
+        std::vector<RuleProfile> Profiles();
+        // A table of the maxRules rules with the most exclusive time
+        std::string Report(int maxRules = 50);
+        // The name of type without namespaces, demangled if needed
+        static std::string RuleName(const std::type_info &type);
+
+    private:
+        class Frame
+        {
+        public:
+            double childTime;
+            RuleProfile *profile;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        std::unordered_map<const void *, RuleProfile> m_rules;
+        std::vector<Frame> m_stack;
+    };
+}
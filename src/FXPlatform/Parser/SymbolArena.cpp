@@ -0,0 +1,74 @@
+#include "SymbolArena.h"
+#include "FXPlatform/FailFast.h"
+#include <algorithm>
+#include <new>
+using namespace FXPlat;
+using namespace std;
+
+SymbolArena::SymbolArena(size_t blockSize) :
+    m_blockSize(blockSize < MaxPooledSize ? MaxPooledSize : blockSize),
+    m_currentBlock(0),
+    m_end(nullptr),
+    m_liveAllocations(0),
+    m_next(nullptr)
+{
+    fill(begin(m_freeLists), end(m_freeLists), nullptr);
+}
+
+SymbolArena::~SymbolArena()
+{
+    // The Symbols still alive would give their memory back to an arena that is gone
+    FailFastAssertDesc(m_liveAllocations == 0, "SymbolArena destroyed while Symbols allocated from it are still alive");
+}
+
+void *SymbolArena::AllocateLarge(size_t size)
+{
+    return ::operator new(size);
+}
+
+void SymbolArena::DeallocateLarge(void *memory)
+{
+    ::operator delete(memory);
+}
+
+void SymbolArena::NextBlock()
+{
+    // The end of the current block is wasted, which is at most MaxPooledSize per block
+    if(m_next != nullptr)
+    {
+        ++m_currentBlock;
+    }
+
+    if(m_currentBlock == m_blocks.size())
+    {
+        m_blocks.push_back(unique_ptr<char[]>(new char[m_blockSize]));
+    }
+
+    m_next = m_blocks[m_currentBlock].get();
+    m_end = m_next + m_blockSize;
+}
+
+bool SymbolArena::Release()
+{
+    if(!Reset())
+    {
+        return false;
+    }
+
+    m_blocks.clear();
+    return true;
+}
+
+bool SymbolArena::Reset()
+{
+    if(m_liveAllocations != 0)
+    {
+        return false;
+    }
+
+    fill(begin(m_freeLists), end(m_freeLists), nullptr);
+    m_currentBlock = 0;
+    m_next = nullptr;
+    m_end = nullptr;
+    return true;
+}
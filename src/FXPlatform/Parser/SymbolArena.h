@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace FXPlat
+{
+    // Allocates the Symbols for a parse out of big blocks instead of one heap allocation per Symbol (and another for its
+    // shared_ptr control block). Set one on the Compiler (or the Lexer) and every Symbol the rules create comes from it, see NewSymbol()
+    // in Parser.h. Symbols are still shared_ptrs and are released like any other, one at a time with their destructors run, but releasing
+    // one just puts its memory on a free list so the rules reuse it for the next Symbol they create (they create and throw away a lot of
+    // them while backtracking). What it saves is the trips to the heap, not the work of tearing down a tree.
+    //
+    // Once every Symbol from a document has been released, Reset() makes all the blocks available again so one arena can be used for
+    // document after document without going back to the heap. Compiler does that at the start of each Compile() and fails if it can't.
+    //
+    // Not thread safe: create and release the Symbols on one thread, and the arena has to outlive them (destroying it first fails fast)
+    class SymbolArena
+    {
+    public:
+        static const size_t DefaultBlockSize = 256 * 1024;
+
+        SymbolArena(size_t blockSize = DefaultBlockSize);
+        ~SymbolArena();
+
+        void *Allocate(size_t size)
+        {
+            size = (size + Alignment - 1) & ~(Alignment - 1);
+            if(size > MaxPooledSize)
+            {
+                return AllocateLarge(size);
+            }
+
+            ++m_liveAllocations;
+            FreeNode *&freeList = m_freeLists[size / Alignment];
+            if(freeList != nullptr)
+            {
+                FreeNode *node = freeList;
+                freeList = node->next;
+                return node;
+            }
+
+            if((size_t) (m_end - m_next) < size)
+            {
+                NextBlock();
+            }
+
+            void *memory = m_next;
+            m_next += size;
+            return memory;
+        }
+
+        void Deallocate(void *memory, size_t size)
+        {
+            size = (size + Alignment - 1) & ~(Alignment - 1);
+            if(size > MaxPooledSize)
+            {
+                DeallocateLarge(memory);
+                return;
+            }
+
+            --m_liveAllocations;
+            FreeNode *node = static_cast<FreeNode *>(memory);
+            node->next = m_freeLists[size / Alignment];
+            m_freeLists[size / Alignment] = node;
+        }
+
+        // If nothing allocated from the arena is still alive, starts allocating from the first block again and returns true.
+        // Otherwise leaves everything alone and returns false
+        bool Reset();
+        // Same as Reset() but gives the blocks back to the heap too
+        bool Release();
+
+        size_t blockCount() { return m_blocks.size(); }
+        size_t blockSize() { return m_blockSize; }
+        long liveAllocations() { return m_liveAllocations; }
+
+    private:
+        class FreeNode
+        {
+        public:
+            FreeNode *next;
+        };
+
+        // Every allocation is rounded up to this so everything in a block is aligned for any type
+        static const size_t Alignment = alignof(std::max_align_t) < 16 ? 16 : alignof(std::max_align_t);
+        // Anything bigger comes from the heap, Symbols are much smaller than this
+        static const size_t MaxPooledSize = 512;
+
+        void *AllocateLarge(size_t size);
+        void DeallocateLarge(void *memory);
+        void NextBlock();
+
+        size_t m_blockSize;
+        std::vector<std::unique_ptr<char[]>> m_blocks;
+        // Index into m_blocks of the block being allocated from
+        size_t m_currentBlock;
+        char *m_end;
+        FreeNode *m_freeLists[MaxPooledSize / Alignment + 1];
+        long m_liveAllocations;
+        char *m_next;
+    };
+
+    // The standard allocator interface for a SymbolArena so that allocate_shared() can put a Symbol and its
+    // control block in the arena together
+    template<class T>
+    class SymbolArenaAllocator
+    {
+    public:
+        typedef T value_type;
+
+        SymbolArenaAllocator(SymbolArena *arena) :
+            m_arena(arena)
+        {
+        }
+
+        template<class Other>
+        SymbolArenaAllocator(const SymbolArenaAllocator<Other> &other) :
+            m_arena(other.arena())
+        {
+        }
+
+        T *allocate(size_t count) { return static_cast<T *>(m_arena->Allocate(count * sizeof(T))); }
+        void deallocate(T *memory, size_t count) { m_arena->Deallocate(memory, count * sizeof(T)); }
+        SymbolArena *arena() const { return m_arena; }
+
+        template<class Other>
+        bool operator==(const SymbolArenaAllocator<Other> &other) const { return m_arena == other.arena(); }
+        template<class Other>
+        bool operator!=(const SymbolArenaAllocator<Other> &other) const { return m_arena != other.arena(); }
+
+    private:
+        SymbolArena *m_arena;
+    };
+}
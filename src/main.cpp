@@ -3,6 +3,7 @@
 #include <cctype>
 #include "FXPlatform/Parser/Compiler.h"
 #include "FXPlatform/Parser/ParserDebug.h"
+#include "FXPlatform/Languages/CssParser.h"
 #include "FXPlatform/Languages/XmlCompiler.h"
 #include <string>
 
@@ -20,18 +21,48 @@ protected:
 	ValueProperty(protected, shared_ptr<vector<shared_ptr<Symbol>>>, result);
 };
 
+// Prints whatever --profile and --timings asked for
+void PrintStats(shared_ptr<RuleProfiler> profiler)
+{
+	if(profiler != nullptr)
+	{
+		fprintf(stdout, "%s\r\n", profiler->Report().c_str());
+	}
+
+	if(NanoTrace::Global().timing())
+	{
+		fprintf(stdout, "%s\r\n", NanoTrace::Global().TimingReport().c_str());
+	}
+}
+
 int main (int argc, char *argv[])
 {
 //	SetTraceFilter(SystemTraceType::Parsing, TraceDetail::Detailed);
 
-	if(argc != 3)
+	// --profile and --timings can come before the other arguments
+	bool profile = false;
+	bool timings = false;
+	int firstArgument = 1;
+	for(; firstArgument < argc; ++firstArgument)
+	{
+		if(string(argv[firstArgument]) == "--profile") { profile = true; }
+		else if(string(argv[firstArgument]) == "--timings") { timings = true; }
+		else { break; }
+	}
+
+	shared_ptr<RuleProfiler> profiler = profile ? shared_ptr<RuleProfiler>(new RuleProfiler()) : nullptr;
+	SetTiming(timings);
+
+	if(argc - firstArgument != 2)
 	{
 		  fprintf(stdout, 
 		  	"IndParse Parser example from https://github.com/EricZinda/InductorParser. \r\n"
 		  	"Parses several types of documents\r\n"
 		  	"and outputs the string representation of their parsed data structure to\r\n"
 		  	"prove it worked.\r\n\r\n"
-		  	"Command line arguments: gparse [language] [file] \r\n"
+		  	"Command line arguments: gparse [--profile] [--timings] [language] [file] \r\n"
+		  	"	--profile: afterwards print how much work each grammar rule did \r\n"
+		  	"	--timings: afterwards print how long loading and parsing the file took \r\n"
 		  	"Examples: \r\n"
 		  	"	gparse xml ./Foo.xml \r\n"
 		  	"	gparse html ./Bar.html \r\n"
@@ -40,8 +71,8 @@ int main (int argc, char *argv[])
 	}
 	else
 	{
-	    string language = string(argv[1]);
-	    string targetFileAndPath = string(argv[2]);
+	    string language = string(argv[firstArgument]);
+	    string targetFileAndPath = string(argv[firstArgument + 1]);
 
 	    if(language == "xml")
 	    {
@@ -50,7 +81,10 @@ int main (int argc, char *argv[])
 	   			);
 
 	    	XmlCompiler compiler;
-	    	if(compiler.CompileDocument(targetFileAndPath))
+	    	compiler.profiler(profiler);
+	    	bool compiled = compiler.CompileDocument(targetFileAndPath);
+	    	PrintStats(profiler);
+	    	if(compiled)
 	    	{
 	    		fprintf(stdout, "%s\r\n", compiler.result()->ToString().c_str());
 	    		return 0;
@@ -70,7 +104,10 @@ int main (int argc, char *argv[])
 	   			"	followed by all children, recursively \r\n\r\n"
 	   			);
 	    	BasicCompiler<Html::HtmlDocumentRule> compiler;
-	    	if(compiler.CompileDocument(targetFileAndPath))
+	    	compiler.profiler(profiler);
+	    	bool compiled = compiler.CompileDocument(targetFileAndPath);
+	    	PrintStats(profiler);
+	    	if(compiled)
 	    	{
 	    		fprintf(stdout, "%s\r\n", ParserDebug::PrintTree(*compiler.result()).c_str());
 	    		return 0;
@@ -81,6 +118,28 @@ int main (int argc, char *argv[])
 	    		return 1;
 	    	}	    	
 	    }
+	    else if(language == "css")
+	    {
+	   		fprintf(stdout, 
+	   			"Printing out symbol tree.  Format is:\r\n" 
+	   			"	[SymbolID] ([FlattenType]): [String representation of node and all children]\r\n"
+	   			"	followed by all children, recursively \r\n\r\n"
+	   			);
+	    	BasicCompiler<Html::CssDocument> compiler;
+	    	compiler.profiler(profiler);
+	    	bool compiled = compiler.CompileDocument(targetFileAndPath);
+	    	PrintStats(profiler);
+	    	if(compiled)
+	    	{
+	    		fprintf(stdout, "%s\r\n", ParserDebug::PrintTree(*compiler.result()).c_str());
+	    		return 0;
+	    	}
+	    	else
+	    	{
+	    		fprintf(stdout, "%s\r\n", compiler.GetErrorString().c_str());
+	    		return 1;
+	    	}
+	    }
 	}
 
   	return 0;